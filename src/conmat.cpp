@@ -1,181 +1,155 @@
 #include "conmat.h"
+#include "conmat_ansi.h"
+#include "conmat_codes.h"
 #include "conmat_config.h"
-#include <regex>
+#include "conmat_simd.h"
+#include "conmat_stats_scope.h"
+#include <charconv>
+#include <cstring>
 #include <sstream>
 
 namespace conmat {
 
 namespace {
 
-// ANSI escape codes
-constexpr const char *RESET = "\033[0m";
+// Number of escape bytes FormatTo adds around the text
+size_t escape_length(const FormatOptions &options) {
+  return detail::get_style_code(options.style).size() +
+         detail::get_fg_color_code(options.foreground).size() +
+         detail::get_bg_color_code(options.background).size() +
+         (options.reset_after ? detail::RESET.size() : 0);
+}
 
-// Get ANSI code for foreground color
-std::string get_fg_color_code(Color color) {
-  switch (color) {
-  case Color::Default:
-    return "";
-  case Color::Black:
-    return "\033[30m";
-  case Color::Red:
-    return "\033[31m";
-  case Color::Green:
-    return "\033[32m";
-  case Color::Yellow:
-    return "\033[33m";
-  case Color::Blue:
-    return "\033[34m";
-  case Color::Magenta:
-    return "\033[35m";
-  case Color::Cyan:
-    return "\033[36m";
-  case Color::White:
-    return "\033[37m";
-  case Color::BrightBlack:
-    return "\033[90m";
-  case Color::BrightRed:
-    return "\033[91m";
-  case Color::BrightGreen:
-    return "\033[92m";
-  case Color::BrightYellow:
-    return "\033[93m";
-  case Color::BrightBlue:
-    return "\033[94m";
-  case Color::BrightMagenta:
-    return "\033[95m";
-  case Color::BrightCyan:
-    return "\033[96m";
-  case Color::BrightWhite:
-    return "\033[97m";
+// Shared implementation of FormatImpl and FormatTo
+void append_formatted(std::string &out, std::string_view text,
+                      const FormatOptions &options) {
+  // Apply style
+  out.append(detail::get_style_code(options.style));
+
+  // Apply foreground color
+  out.append(detail::get_fg_color_code(options.foreground));
+
+  // Apply background color
+  out.append(detail::get_bg_color_code(options.background));
+
+  // Add the sanitized text
+  detail::AppendSanitized(out, text);
+
+  // Reset if requested
+  if (options.reset_after) {
+    out.append(detail::RESET);
   }
-  return "";
 }
 
-// Get ANSI code for background color
-std::string get_bg_color_code(Color color) {
-  switch (color) {
-  case Color::Default:
-    return "";
-  case Color::Black:
-    return "\033[40m";
-  case Color::Red:
-    return "\033[41m";
-  case Color::Green:
-    return "\033[42m";
-  case Color::Yellow:
-    return "\033[43m";
-  case Color::Blue:
-    return "\033[44m";
-  case Color::Magenta:
-    return "\033[45m";
-  case Color::Cyan:
-    return "\033[46m";
-  case Color::White:
-    return "\033[47m";
-  case Color::BrightBlack:
-    return "\033[100m";
-  case Color::BrightRed:
-    return "\033[101m";
-  case Color::BrightGreen:
-    return "\033[102m";
-  case Color::BrightYellow:
-    return "\033[103m";
-  case Color::BrightBlue:
-    return "\033[104m";
-  case Color::BrightMagenta:
-    return "\033[105m";
-  case Color::BrightCyan:
-    return "\033[106m";
-  case Color::BrightWhite:
-    return "\033[107m";
+// Shared implementation of Sanitize and SanitizeView
+std::string_view sanitize_view(std::string_view text, std::string &storage) {
+  // Filter out control characters except common whitespace; printable
+  // ASCII and bytes >= 0x80 (UTF-8) are kept
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  const char *unsafe = detail::FindUnsafeByte(begin, end);
+  if (unsafe == end) {
+    return text;
   }
-  return "";
-}
 
-// Get ANSI code for text style
-std::string get_style_code(Style style) {
-  switch (style) {
-  case Style::Default:
-    return "";
-  case Style::Bold:
-    return "\033[1m";
-  case Style::Dim:
-    return "\033[2m";
-  case Style::Italic:
-    return "\033[3m";
-  case Style::Underline:
-    return "\033[4m";
-  case Style::Blink:
-    return "\033[5m";
-  case Style::Reverse:
-    return "\033[7m";
-  case Style::Hidden:
-    return "\033[8m";
-  case Style::Strikethrough:
-    return "\033[9m";
+  storage.clear();
+  storage.reserve(text.size() - 1);
+  storage.append(begin, unsafe);
+  while (unsafe != end) {
+    const char *run = unsafe + 1;
+    unsafe = detail::FindUnsafeByte(run, end);
+    storage.append(run, unsafe);
   }
-  return "";
+  return storage;
 }
 
 } // anonymous namespace
 
 std::string FormatImpl(std::string_view text, const FormatOptions &options) {
-  // Sanitize input first
-  std::string safe_text = Sanitize(text);
-
-  std::ostringstream result;
+  CONMAT_STATS_SCOPE(stats::Api::FormatImpl, text.size());
+  std::string result;
+  // Size for clean input; dirty input only gets shorter
+  result.reserve(escape_length(options) + text.size());
+  append_formatted(result, text, options);
+  CONMAT_STATS_OUTPUT(result.size(), escape_length(options));
+  return result;
+}
 
-  // Apply style
-  result << get_style_code(options.style);
+void FormatTo(std::string &out, std::string_view text,
+              const FormatOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::FormatTo, text.size());
+  [[maybe_unused]] size_t start = out.size();
+  append_formatted(out, text, options);
+  CONMAT_STATS_OUTPUT(out.size() - start, escape_length(options));
+}
 
-  // Apply foreground color
-  result << get_fg_color_code(options.foreground);
+namespace detail {
+std::string_view NumberToText(char *buffer, long long value) {
+  auto result = std::to_chars(buffer, buffer + kNumberBufferSize, value);
+  return std::string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+}
 
-  // Apply background color
-  result << get_bg_color_code(options.background);
+std::string_view NumberToText(char *buffer, unsigned long long value) {
+  auto result = std::to_chars(buffer, buffer + kNumberBufferSize, value);
+  return std::string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+}
 
-  // Add the text
-  result << safe_text;
+std::string_view NumberToText(char *buffer, double value) {
+  // std::ostream default: general format with precision 6
+  auto result = std::to_chars(buffer, buffer + kNumberBufferSize, value,
+                              std::chars_format::general, 6);
+  return std::string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+}
 
-  // Reset if requested
-  if (options.reset_after) {
-    result << RESET;
-  }
+std::string_view NumberToText(char *buffer, long double value) {
+  auto result = std::to_chars(buffer, buffer + kNumberBufferSize, value,
+                              std::chars_format::general, 6);
+  return std::string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+}
 
-  return result.str();
+std::string StreamToString(const void *value,
+                           void (*write)(std::ostream &, const void *)) {
+  std::ostringstream oss;
+  write(oss, value);
+  return oss.str();
 }
+} // namespace detail
 
 std::string Divider(std::string_view symbol, size_t width,
                     const FormatOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::Divider, symbol.size());
   if (symbol.empty() || width == 0) {
     return "";
   }
 
   // Sanitize the symbol to prevent injection
   std::string safe_symbol = Sanitize(symbol);
+  if (safe_symbol.empty()) {
+    return "";
+  }
 
   // Build the divider by repeating the symbol
-  std::ostringstream result;
+  std::string divider;
+  divider.reserve(width);
   size_t symbol_length = safe_symbol.length();
   size_t full_repeats = width / symbol_length;
   size_t remaining = width % symbol_length;
 
   for (size_t i = 0; i < full_repeats; ++i) {
-    result << safe_symbol;
+    divider.append(safe_symbol);
   }
 
   // Add remaining characters if needed
-  if (remaining > 0) {
-    result << safe_symbol.substr(0, remaining);
-  }
+  divider.append(safe_symbol, 0, remaining);
 
   // Apply formatting if any
   if (options.foreground != Color::Default ||
       options.background != Color::Default || options.style != Style::Default) {
-    return FormatImpl(result.str(), options);
+    divider = FormatImpl(divider, options);
   }
 
-  return result.str();
+  CONMAT_STATS_OUTPUT(divider.size(), divider.size() - width);
+  return divider;
 }
 
 std::string Divider(size_t width, const FormatOptions &options) {
@@ -184,33 +158,80 @@ std::string Divider(size_t width, const FormatOptions &options) {
 }
 
 std::string Sanitize(std::string_view text) {
+  CONMAT_STATS_SCOPE(stats::Api::Sanitize, text.size());
   std::string result;
-  result.reserve(text.length());
+  std::string_view safe = sanitize_view(text, result);
+  if (safe.data() != result.data()) {
+    // Clean input was returned as is
+    result.assign(text);
+  }
+  CONMAT_STATS_OUTPUT(result.size(), 0);
+  return result;
+}
 
-  for (char c : text) {
-    // Filter out control characters except common whitespace
-    if (c >= 32 && c <= 126) {
-      // Printable ASCII
-      result += c;
-    } else if (c == '\n' || c == '\t' || c == '\r') {
-      // Allow common whitespace
-      result += c;
-    } else if (static_cast<unsigned char>(c) >= 128) {
-      // Allow UTF-8 continuation bytes and high characters
-      result += c;
-    }
-    // Skip other control characters (including potential ANSI escape sequences)
+bool NeedsSanitize(std::string_view text) {
+  const char *end = text.data() + text.size();
+  return detail::FindUnsafeByte(text.data(), end) != end;
+}
+
+std::string_view SanitizeView(std::string_view text, std::string &storage) {
+  CONMAT_STATS_SCOPE(stats::Api::SanitizeView, text.size());
+  std::string_view safe = sanitize_view(text, storage);
+  CONMAT_STATS_OUTPUT(safe.size(), 0);
+  return safe;
+}
+
+namespace detail {
+void AppendSanitized(std::string &out, std::string_view text) {
+  // Clean input is appended in one block, dirty input is sanitized
+  // straight into the output without a temporary
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  const char *unsafe = FindUnsafeByte(begin, end);
+  out.append(begin, unsafe);
+  while (unsafe != end) {
+    const char *run = unsafe + 1;
+    unsafe = FindUnsafeByte(run, end);
+    out.append(run, unsafe);
   }
+}
 
-  return result;
+void SanitizeInPlace(std::string &text) {
+  CONMAT_STATS_SCOPE(stats::Api::Sanitize, text.size());
+  char *begin = text.data();
+  char *end = begin + text.size();
+  char *write = const_cast<char *>(FindUnsafeByte(begin, end));
+  if (write == end) {
+    return;
+  }
+
+  // Compact the remaining clean runs over the removed bytes
+  const char *read = write;
+  while (read != end) {
+    const char *run = read + 1;
+    read = FindUnsafeByte(run, end);
+    size_t length = static_cast<size_t>(read - run);
+    std::memmove(write, run, length);
+    write += length;
+  }
+  text.resize(static_cast<size_t>(write - begin));
+  CONMAT_STATS_OUTPUT(text.size(), 0);
 }
+} // namespace detail
 
 std::string StripAnsi(std::string_view text) {
-  // Remove ANSI escape sequences using regex
-  // Pattern matches: ESC [ ... m (and other ANSI codes)
-  std::string str(text);
-  std::regex ansi_regex("\033\\[[0-9;]*[A-Za-z]");
-  return std::regex_replace(str, ansi_regex, "");
+  CONMAT_STATS_SCOPE(stats::Api::StripAnsi, text.size());
+  // Keep the text runs; every escape sequence, including an unterminated
+  // one at the end of the input, is dropped
+  std::string result;
+  result.reserve(text.length());
+  for (const AnsiToken &token : AnsiTokenizer(text)) {
+    if (token.kind == AnsiTokenKind::Text) {
+      result.append(token.text);
+    }
+  }
+  CONMAT_STATS_OUTPUT(result.size(), 0);
+  return result;
 }
 
 std::string TestInProgress() { return Colorize("[...]", Color::Yellow); }
@@ -220,11 +241,14 @@ std::string TestPassed() { return Colorize("[✓]", Color::Green); }
 std::string TestFailed() { return Colorize("[✗]", Color::Red); }
 
 std::string Indent(size_t level, size_t spaces_per_level) {
+  CONMAT_STATS_SCOPE(stats::Api::Indent, 0);
+  CONMAT_STATS_OUTPUT(level * spaces_per_level, 0);
   return std::string(level * spaces_per_level, ' ');
 }
 
 std::string Header(std::string value, size_t level, size_t width,
                    const FormatOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::Header, value.size());
 
   // Determine the padding character based on level
   char padding_char;
@@ -243,40 +267,38 @@ std::string Header(std::string value, size_t level, size_t width,
     break;
   }
 
-  // Helper lambda to apply formatting if needed
-  auto apply_formatting = [&options](const std::string &text) -> std::string {
-    if (options.foreground != Color::Default ||
-        options.background != Color::Default ||
-        options.style != Style::Default) {
-      return FormatImpl(text, options);
-    }
-    return text;
-  };
-
   // Calculate padding needed on each side
   // Format: "=== text ===" with at least 3 padding chars on each side
   size_t min_padding = 3;
   size_t text_length = value.length();
-  size_t total_padding_needed =
-      width - text_length - 2; // 2 for spaces around text
+  size_t left_padding = min_padding;
+  size_t right_padding = min_padding;
 
   // If the text is too long, just wrap with minimum padding
-  if (text_length + 2 + (2 * min_padding) > width) {
-    std::ostringstream result;
-    result << std::string(min_padding, padding_char) << ' ' << value << ' '
-           << std::string(min_padding, padding_char);
-    return apply_formatting(result.str());
+  if (text_length + 2 + (2 * min_padding) <= width) {
+    // Calculate balanced padding
+    size_t total_padding_needed =
+        width - text_length - 2; // 2 for spaces around text
+    left_padding = total_padding_needed / 2;
+    right_padding = total_padding_needed - left_padding;
   }
 
-  // Calculate balanced padding
-  size_t left_padding = total_padding_needed / 2;
-  size_t right_padding = total_padding_needed - left_padding;
-
-  // Build the header
-  std::ostringstream result;
-  result << std::string(left_padding, padding_char) << ' ' << value << ' '
-         << std::string(right_padding, padding_char);
-
-  return apply_formatting(result.str());
+  // Build the header in one allocation
+  std::string header;
+  header.reserve(left_padding + text_length + right_padding + 2);
+  header.append(left_padding, padding_char);
+  header.push_back(' ');
+  header.append(value);
+  header.push_back(' ');
+  header.append(right_padding, padding_char);
+
+  // Apply formatting if needed
+  [[maybe_unused]] size_t plain_length = header.size();
+  if (options.foreground != Color::Default ||
+      options.background != Color::Default || options.style != Style::Default) {
+    header = FormatImpl(header, options);
+  }
+  CONMAT_STATS_OUTPUT(header.size(), header.size() - plain_length);
+  return header;
 }
 } // namespace conmat
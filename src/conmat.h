@@ -1,35 +1,64 @@
 #pragma once
 
-#include <concepts>
-#include <sstream>
+// Heavy standard headers stay behind the implementation boundary: this
+// header only needs <iosfwd>. Include conmat_stream.h for std::ostream
+// helpers.
+
+#include <cstddef>
+#include <iosfwd>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 
 namespace conmat {
 
+namespace detail {
+/// \brief Exact type match (std::same_as without <concepts>)
+template <typename A, typename B>
+concept SameAs = std::is_same_v<A, B> && std::is_same_v<B, A>;
+
+/// \brief Types formatted through a string_view without copying
+template <typename T>
+concept StringLike = std::is_convertible_v<const T &, std::string_view>;
+
+/// \brief Types printed as a single character by std::ostream
+template <typename T>
+concept CharLike = std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+                   std::is_same_v<T, unsigned char>;
+
+/// \brief Arithmetic types formatted without std::ostream
+template <typename T>
+concept NumberLike =
+    std::is_arithmetic_v<T> && !std::is_same_v<T, wchar_t> &&
+    !std::is_same_v<T, char8_t> && !std::is_same_v<T, char16_t> &&
+    !std::is_same_v<T, char32_t>;
+} // namespace detail
+
 ////////////////////////////////////////////////////////////
-/// \brief Concept for types that can be streamed to ostream
+/// \brief Concept for types with a non-member operator<< for ostream
+///
+/// Only non-member operators count: std::ostream is incomplete here, so
+/// its member operator<< overloads (pointers, for example) are not
+/// visible, and checking them would give a different answer in files
+/// that include <ostream>. Format such values as strings.
 ///
 ////////////////////////////////////////////////////////////
 template <typename T>
-concept Streamable = requires(std::ostream &os, T value) {
-  { os << value } -> std::same_as<std::ostream &>;
+concept Streamable = requires(std::ostream &os, const T &value) {
+  { operator<<(os, value) } -> detail::SameAs<std::ostream &>;
 };
 
-namespace detail {
-/// \brief Convert any streamable type to string
-template <Streamable T> std::string to_string(const T &value) {
-  if constexpr (std::is_same_v<T, std::string> ||
-                std::is_same_v<T, std::string_view> ||
-                std::is_same_v<T, const char *>) {
-    return std::string(value);
-  } else {
-    std::ostringstream oss;
-    oss << value;
-    return oss.str();
-  }
-}
-} // namespace detail
+////////////////////////////////////////////////////////////
+/// \brief Concept for values accepted by Format, Colorize and Stylize
+///
+/// Strings, characters, booleans and numbers are converted without
+/// iostreams; any other type must be Streamable.
+///
+////////////////////////////////////////////////////////////
+template <typename T>
+concept Formattable = detail::StringLike<T> || detail::NumberLike<T> ||
+                      Streamable<T>;
 
 ////////////////////////////////////////////////////////////
 /// \brief ANSI color codes enum
@@ -99,6 +128,72 @@ struct FormatOptions {
 std::string FormatImpl(std::string_view text,
                        const FormatOptions &options = {});
 
+////////////////////////////////////////////////////////////
+/// \brief Append a string formatted with ANSI codes to a buffer
+///
+/// Same output as FormatImpl, but appended to an existing buffer so a
+/// reused buffer formats without allocating.
+///
+/// \param out String the formatted text is appended to
+/// \param text The text to format
+/// \param options Format options (default: no formatting)
+///
+////////////////////////////////////////////////////////////
+void FormatTo(std::string &out, std::string_view text,
+              const FormatOptions &options = {});
+
+namespace detail {
+/// \brief Buffer size that fits any number formatted by NumberToText
+inline constexpr size_t kNumberBufferSize = 64;
+
+/// \brief Format numbers the way std::ostream does by default
+/// (integers in decimal, floating point as "%g" with precision 6)
+std::string_view NumberToText(char *buffer, long long value);
+std::string_view NumberToText(char *buffer, unsigned long long value);
+std::string_view NumberToText(char *buffer, double value);
+std::string_view NumberToText(char *buffer, long double value);
+
+/// \brief Stream a value into a string (std::ostringstream lives in
+/// conmat.cpp so this header does not need <sstream>)
+std::string StreamToString(const void *value,
+                           void (*write)(std::ostream &, const void *));
+
+/// \brief Format a Formattable value with FormatImpl
+template <typename T>
+std::string FormatValue(const T &value, const FormatOptions &options) {
+  if constexpr (StringLike<T>) {
+    return FormatImpl(std::string_view(value), options);
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return FormatImpl(value ? "1" : "0", options);
+  } else if constexpr (CharLike<T>) {
+    char c = static_cast<char>(value);
+    return FormatImpl(std::string_view(&c, 1), options);
+  } else if constexpr (NumberLike<T>) {
+    char buffer[kNumberBufferSize];
+    if constexpr (std::is_floating_point_v<T>) {
+      using Float = std::conditional_t<std::is_same_v<T, long double>,
+                                       long double, double>;
+      return FormatImpl(NumberToText(buffer, static_cast<Float>(value)),
+                        options);
+    } else if constexpr (std::is_signed_v<T>) {
+      return FormatImpl(NumberToText(buffer, static_cast<long long>(value)),
+                        options);
+    } else {
+      return FormatImpl(
+          NumberToText(buffer, static_cast<unsigned long long>(value)),
+          options);
+    }
+  } else {
+    return FormatImpl(StreamToString(&value,
+                                     [](std::ostream &os, const void *p) {
+                                       operator<<(
+                                           os, *static_cast<const T *>(p));
+                                     }),
+                      options);
+  }
+}
+} // namespace detail
+
 ////////////////////////////////////////////////////////////
 /// \brief Format any streamable value with ANSI codes
 /// \param value The value to format (can be any type streamable to cout)
@@ -106,9 +201,9 @@ std::string FormatImpl(std::string_view text,
 /// \return Formatted string with ANSI codes
 ///
 ////////////////////////////////////////////////////////////
-template <Streamable T>
+template <Formattable T>
 std::string Format(const T &value, const FormatOptions &options = {}) {
-  return FormatImpl(detail::to_string(value), options);
+  return detail::FormatValue(value, options);
 }
 
 ////////////////////////////////////////////////////////////
@@ -118,10 +213,10 @@ std::string Format(const T &value, const FormatOptions &options = {}) {
 /// \return Formatted string with color
 ///
 ////////////////////////////////////////////////////////////
-template <Streamable T> std::string Colorize(const T &value, Color color) {
+template <Formattable T> std::string Colorize(const T &value, Color color) {
   FormatOptions options;
   options.foreground = color;
-  return FormatImpl(detail::to_string(value), options);
+  return detail::FormatValue(value, options);
 }
 
 ////////////////////////////////////////////////////////////
@@ -131,10 +226,10 @@ template <Streamable T> std::string Colorize(const T &value, Color color) {
 /// \return Formatted string with style
 ///
 ////////////////////////////////////////////////////////////
-template <Streamable T> std::string Stylize(const T &value, Style style) {
+template <Formattable T> std::string Stylize(const T &value, Style style) {
   FormatOptions options;
   options.style = style;
-  return FormatImpl(detail::to_string(value), options);
+  return detail::FormatValue(value, options);
 }
 
 ////////////////////////////////////////////////////////////
@@ -165,8 +260,61 @@ std::string Divider(size_t width = 80, const FormatOptions &options = {});
 ////////////////////////////////////////////////////////////
 std::string Sanitize(std::string_view text);
 
+////////////////////////////////////////////////////////////
+/// \brief Check whether Sanitize would change a string
+///
+/// Vectorized scan for control characters; no allocation.
+///
+/// \param text The text to check
+/// \return True if text contains bytes that Sanitize removes
+///
+////////////////////////////////////////////////////////////
+bool NeedsSanitize(std::string_view text);
+
+////////////////////////////////////////////////////////////
+/// \brief Sanitize without copying clean input
+///
+/// Returns text itself when it is already clean. Otherwise the sanitized
+/// copy is written to storage and a view of storage is returned.
+///
+/// \param text The text to sanitize
+/// \param storage Buffer used only when text needs sanitizing
+/// \return View of the sanitized text (text or storage)
+///
+////////////////////////////////////////////////////////////
+std::string_view SanitizeView(std::string_view text, std::string &storage);
+
+namespace detail {
+/// \brief Remove unsafe bytes from a string in place
+void SanitizeInPlace(std::string &text);
+
+/// \brief Append text to out with unsafe bytes removed
+void AppendSanitized(std::string &out, std::string_view text);
+} // namespace detail
+
+////////////////////////////////////////////////////////////
+/// \brief Sanitize a string by compacting it in place
+///
+/// Overload for rvalue std::string: reuses the string's buffer instead
+/// of allocating a copy.
+///
+/// \param text The text to sanitize
+/// \return The sanitized string
+///
+////////////////////////////////////////////////////////////
+template <typename S>
+  requires detail::SameAs<S, std::string>
+std::string Sanitize(S &&text) {
+  detail::SanitizeInPlace(text);
+  return std::move(text);
+}
+
 ////////////////////////////////////////////////////////////
 /// \brief Strip ANSI codes from a string
+///
+/// Removes CSI (colors, cursor movement), OSC (titles, hyperlinks) and
+/// other escape sequences. Use AnsiStripper for chunked input.
+///
 /// \param text The text to strip codes from
 /// \return Plain text without ANSI codes
 ///
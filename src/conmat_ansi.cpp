@@ -0,0 +1,380 @@
+#include "conmat_ansi.h"
+#include "conmat.h"
+#include "conmat_stats_scope.h"
+#include <charconv>
+
+namespace conmat {
+
+namespace {
+
+// xterm default RGB values of the 16 basic colors
+constexpr uint8_t kBasicPalette[16][3] = {
+    {0, 0, 0},       {205, 0, 0},     {0, 205, 0},     {205, 205, 0},
+    {0, 0, 238},     {205, 0, 205},   {0, 205, 205},   {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0},     {0, 255, 0},     {255, 255, 0},
+    {92, 92, 255},   {255, 0, 255},   {0, 255, 255},   {255, 255, 255}};
+
+// Maximum number of numeric parameters considered in one SGR sequence
+constexpr size_t kMaxSgrValues = 32;
+
+// SGR parameters split into values; values sharing a group came from one
+// ';' separated parameter with ':' sub-parameters
+struct SgrValues {
+  uint32_t value[kMaxSgrValues];
+  uint8_t group[kMaxSgrValues];
+  size_t count = 0;
+};
+
+SgrValues SplitSgr(std::string_view parameters) {
+  SgrValues values;
+  uint8_t group = 0;
+  uint32_t current = 0;
+  for (size_t i = 0; i <= parameters.size(); ++i) {
+    char c = i < parameters.size() ? parameters[i] : ';';
+    if (c >= '0' && c <= '9') {
+      current = current < 100000 ? current * 10 + static_cast<uint32_t>(c - '0')
+                                 : current;
+      continue;
+    }
+    if (values.count < kMaxSgrValues) {
+      values.value[values.count] = current;
+      values.group[values.count] = group;
+      ++values.count;
+    }
+    current = 0;
+    if (c == ';') {
+      ++group;
+    }
+  }
+  return values;
+}
+
+uint8_t ClampByte(uint32_t value) {
+  return static_cast<uint8_t>(value > 255 ? 255 : value);
+}
+
+// Parse an extended color (38/48) starting at values[i]; returns the
+// number of values consumed
+size_t ParseExtendedColor(const SgrValues &values, size_t i, SgrColor &color) {
+  size_t start = i;
+  uint8_t group = values.group[i];
+  bool colon_form = i + 1 < values.count && values.group[i + 1] == group;
+  ++i;
+  if (i >= values.count) {
+    return i - start;
+  }
+
+  uint32_t mode = values.value[i++];
+  size_t available = 0;
+  while (i + available < values.count &&
+         (!colon_form || values.group[i + available] == group)) {
+    ++available;
+  }
+
+  if (mode == 5 && available >= 1) {
+    color.kind = SgrColor::Kind::Indexed;
+    color.index = ClampByte(values.value[i]);
+    i += 1;
+  } else if (mode == 2 && available >= 3) {
+    // The colon form may carry a color space id before the components
+    if (colon_form && available >= 4) {
+      ++i;
+    }
+    color.kind = SgrColor::Kind::Rgb;
+    color.red = ClampByte(values.value[i]);
+    color.green = ClampByte(values.value[i + 1]);
+    color.blue = ClampByte(values.value[i + 2]);
+    i += 3;
+  }
+
+  // Skip whatever is left of a colon group
+  while (colon_form && i < values.count && values.group[i] == group) {
+    ++i;
+  }
+  return i - start;
+}
+
+void AppendNumber(std::string &out, unsigned value) {
+  char digits[4];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  out.append(digits, result.ptr);
+}
+
+void AppendColor(std::string &out, const SgrColor &color, unsigned base) {
+  // base is 30 for foreground and 40 for background
+  switch (color.kind) {
+  case SgrColor::Kind::Default:
+    return;
+  case SgrColor::Kind::Indexed:
+    if (color.index < 8) {
+      AppendNumber(out, base + color.index);
+    } else if (color.index < 16) {
+      AppendNumber(out, base + 60 + color.index - 8);
+    } else {
+      AppendNumber(out, base + 8);
+      out.append(";5;");
+      AppendNumber(out, color.index);
+    }
+    break;
+  case SgrColor::Kind::Rgb:
+    AppendNumber(out, base + 8);
+    out.append(";2;");
+    AppendNumber(out, color.red);
+    out.push_back(';');
+    AppendNumber(out, color.green);
+    out.push_back(';');
+    AppendNumber(out, color.blue);
+    break;
+  }
+  out.push_back(';');
+}
+
+// Parser handler that keeps text runs and discards every sequence
+struct StripHandler {
+  std::string &out;
+
+  void OnText(std::string_view text) { out.append(text); }
+  void OnSequence(const AnsiSequence &) {}
+};
+
+// Check whether SGR parameters leave a code SgrState does not model
+// (overline, fonts, underline color, ...) active. A reset clears them.
+bool SetsUntrackedCode(std::string_view parameters, bool untracked) {
+  SgrValues values = SplitSgr(parameters);
+  for (size_t i = 0; i < values.count;) {
+    uint32_t code = values.value[i];
+    if (code == 38 || code == 48) {
+      SgrColor ignored;
+      i += ParseExtendedColor(values, i, ignored);
+      continue;
+    }
+    if (code == 0) {
+      untracked = false;
+    } else if (!((code >= 1 && code <= 9) || (code >= 21 && code <= 25) ||
+                 (code >= 27 && code <= 37) || (code >= 39 && code <= 47) ||
+                 code == 49 || (code >= 90 && code <= 97) ||
+                 (code >= 100 && code <= 107))) {
+      untracked = true;
+    }
+    ++i;
+  }
+  return untracked;
+}
+
+// Restrict a state to the 16 basic colors
+SgrColor ToBasicColor(const SgrColor &color) {
+  int index = color.BasicIndex();
+  if (index < 0) {
+    return {};
+  }
+  return {SgrColor::Kind::Indexed, static_cast<uint8_t>(index)};
+}
+
+} // anonymous namespace
+
+// Parser handler that keeps text runs and SGR sequences
+struct SgrSanitizer::Handler {
+  SgrSanitizer &sanitizer;
+  std::string &out;
+
+  void OnText(std::string_view text) { detail::AppendSanitized(out, text); }
+
+  void OnSequence(const AnsiSequence &sequence) {
+    if (sequence.type != AnsiSequenceType::Sgr) {
+      return;
+    }
+    SgrState &input = sanitizer.input_;
+    SgrState &emitted = sanitizer.emitted_;
+    // Plain resets are the most common sequence; skip parsing them
+    bool reset = sequence.parameters.empty() || sequence.parameters == "0";
+    if (reset) {
+      input = SgrState{};
+    } else {
+      input.Apply(sequence.parameters);
+    }
+
+    if (sanitizer.policy_ == SgrPolicy::Any) {
+      out.append("\033[");
+      out.append(sequence.parameters);
+      out.push_back('m');
+      emitted = input;
+      sanitizer.untracked_ =
+          !reset &&
+          SetsUntrackedCode(sequence.parameters, sanitizer.untracked_);
+      return;
+    }
+
+    SgrState basic = input;
+    basic.foreground = ToBasicColor(input.foreground);
+    basic.background = ToBasicColor(input.background);
+    if (basic == emitted) {
+      return;
+    }
+    if (basic.IsDefault()) {
+      out.append("\033[0m");
+    } else {
+      size_t before = out.size();
+      basic.AppendTo(out);
+      if (!emitted.IsDefault()) {
+        // One sequence clears the previous state and sets the next
+        out.insert(before + 2, "0;");
+      }
+    }
+    emitted = basic;
+  }
+};
+
+int SgrColor::BasicIndex() const {
+  uint8_t r = red;
+  uint8_t g = green;
+  uint8_t b = blue;
+  switch (kind) {
+  case Kind::Default:
+    return -1;
+  case Kind::Indexed:
+    if (index < 16) {
+      return index;
+    }
+    if (index < 232) {
+      // 6x6x6 color cube
+      constexpr uint8_t levels[6] = {0, 95, 135, 175, 215, 255};
+      int cube = index - 16;
+      r = levels[cube / 36];
+      g = levels[(cube / 6) % 6];
+      b = levels[cube % 6];
+    } else {
+      // Grayscale ramp
+      r = g = b = static_cast<uint8_t>(8 + 10 * (index - 232));
+    }
+    break;
+  case Kind::Rgb:
+    break;
+  }
+
+  int best = 0;
+  int best_distance = -1;
+  for (int i = 0; i < 16; ++i) {
+    int dr = r - kBasicPalette[i][0];
+    int dg = g - kBasicPalette[i][1];
+    int db = b - kBasicPalette[i][2];
+    int distance = dr * dr + dg * dg + db * db;
+    if (best_distance < 0 || distance < best_distance) {
+      best = i;
+      best_distance = distance;
+    }
+  }
+  return best;
+}
+
+void SgrState::Apply(std::string_view parameters) {
+  SgrValues values = SplitSgr(parameters);
+
+  for (size_t i = 0; i < values.count;) {
+    uint32_t code = values.value[i];
+    if (code == 38 || code == 48) {
+      i += ParseExtendedColor(values, i,
+                              code == 38 ? foreground : background);
+      continue;
+    }
+
+    if (code == 0) {
+      *this = SgrState{};
+    } else if (code >= 1 && code <= 9 && code != 6) {
+      // 1-9 map onto the attribute bits in order, 6 (rapid blink) aside
+      attributes |= static_cast<uint16_t>(1u << (code < 6 ? code - 1 : code - 2));
+    } else if (code == 6) {
+      attributes |= sgr_attribute::Blink;
+    } else if (code == 21) {
+      attributes |= sgr_attribute::Underline;
+    } else if (code == 22) {
+      attributes &= static_cast<uint16_t>(
+          ~(sgr_attribute::Bold | sgr_attribute::Dim));
+    } else if (code == 23) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Italic);
+    } else if (code == 24) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Underline);
+    } else if (code == 25) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Blink);
+    } else if (code == 27) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Reverse);
+    } else if (code == 28) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Hidden);
+    } else if (code == 29) {
+      attributes &= static_cast<uint16_t>(~sgr_attribute::Strikethrough);
+    } else if (code >= 30 && code <= 37) {
+      foreground = {SgrColor::Kind::Indexed, static_cast<uint8_t>(code - 30)};
+    } else if (code == 39) {
+      foreground = {};
+    } else if (code >= 40 && code <= 47) {
+      background = {SgrColor::Kind::Indexed, static_cast<uint8_t>(code - 40)};
+    } else if (code == 49) {
+      background = {};
+    } else if (code >= 90 && code <= 97) {
+      foreground = {SgrColor::Kind::Indexed, static_cast<uint8_t>(code - 82)};
+    } else if (code >= 100 && code <= 107) {
+      background = {SgrColor::Kind::Indexed, static_cast<uint8_t>(code - 92)};
+    }
+    // Unsupported codes (fonts, overline, ...) are ignored
+    ++i;
+  }
+}
+
+void SgrState::AppendTo(std::string &out) const {
+  if (IsDefault()) {
+    return;
+  }
+
+  size_t start = out.size();
+  out.append("\033[");
+  for (unsigned bit = 0; bit < 8; ++bit) {
+    if (attributes & (1u << bit)) {
+      // Inverse of the mapping in Apply: bits 0-4 are codes 1-5, 5-7 are 7-9
+      AppendNumber(out, bit < 5 ? bit + 1 : bit + 2);
+      out.push_back(';');
+    }
+  }
+  AppendColor(out, foreground, 30);
+  AppendColor(out, background, 40);
+
+  // Replace the trailing ';' with the final byte
+  if (out.size() > start + 2) {
+    out.back() = 'm';
+  }
+}
+
+void AnsiStripper::Feed(std::string_view chunk, std::string &out) {
+  CONMAT_STATS_SCOPE(stats::Api::AnsiStripper, chunk.size());
+  [[maybe_unused]] size_t start = out.size();
+  StripHandler handler{out};
+  parser_.Feed(chunk, handler);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void SgrSanitizer::Feed(std::string_view chunk, std::string &out) {
+  CONMAT_STATS_SCOPE(stats::Api::SanitizeSgr, chunk.size());
+  [[maybe_unused]] size_t start = out.size();
+  Handler handler{*this, out};
+  parser_.Feed(chunk, handler);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void SgrSanitizer::Finish(std::string &out) {
+  if (!emitted_.IsDefault() || untracked_) {
+    out.append("\033[0m");
+  }
+  parser_.Reset();
+  input_ = SgrState{};
+  emitted_ = SgrState{};
+  untracked_ = false;
+}
+
+std::string SanitizeSgr(std::string_view text, SgrPolicy policy) {
+  std::string result;
+  result.reserve(text.size() + 4);
+  SgrSanitizer sanitizer(policy);
+  sanitizer.Feed(text, result);
+  sanitizer.Finish(result);
+  return result;
+}
+
+} // namespace conmat
@@ -0,0 +1,797 @@
+#pragma once
+
+#include "conmat_simd.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Classification of a complete escape sequence
+///
+////////////////////////////////////////////////////////////
+enum class AnsiSequenceType {
+  Sgr,  // ESC [ <digits ; :> m  (colors and styles)
+  Csi,  // any other ESC [ ... <final>
+  Osc,  // ESC ] ... BEL or ESC ] ... ESC '\'
+  Other // two byte escapes, nF escapes, DCS/SOS/PM/APC strings
+};
+
+////////////////////////////////////////////////////////////
+/// \brief A complete escape sequence reported by AnsiStreamParser
+///
+/// The views point into parser owned storage and are only valid for the
+/// duration of the OnSequence callback.
+///
+////////////////////////////////////////////////////////////
+struct AnsiSequence {
+  AnsiSequenceType type = AnsiSequenceType::Other;
+  std::string_view parameters;    // CSI parameter bytes (0x30-0x3F)
+  std::string_view intermediates; // CSI / nF intermediate bytes (0x20-0x2F)
+  char final_byte = '\0';         // CSI / escape final byte
+  bool malformed = false;         // parameters overflowed or were misordered
+};
+
+/// \brief Longest CSI parameter/intermediate run still accepted as SGR
+inline constexpr size_t kMaxAnsiParameterBytes = 64;
+
+////////////////////////////////////////////////////////////
+/// \brief Kind of token produced by AnsiTokenizer
+///
+////////////////////////////////////////////////////////////
+enum class AnsiTokenKind : uint8_t {
+  Text,  // run of bytes without ESC
+  Sgr,   // ESC [ <digits ; :> m
+  Csi,   // any other ESC [ ... <final>
+  Osc,   // ESC ] ... BEL or ESC ] ... ESC '\'
+  Other  // two byte escapes, nF escapes, DCS/SOS/PM/APC, lone ESC
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Numeric parameters of an SGR sequence
+///
+/// Iterates the ';' and ':' separated values of a parameter string
+/// without allocating; empty values read as 0, so "ESC [ m" yields a
+/// single 0 (reset).
+///
+/// \example
+/// for (uint32_t value : SgrParameters("1;38;5;196")) { ... }  // 1 38 5 196
+///
+////////////////////////////////////////////////////////////
+class SgrParameters {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = uint32_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const uint32_t *;
+    using reference = uint32_t;
+
+    constexpr iterator() = default;
+    constexpr iterator(const char *pos, const char *end) : end_(end) {
+      Parse(pos);
+    }
+
+    constexpr uint32_t operator*() const { return value_; }
+
+    constexpr iterator &operator++() {
+      Parse(next_);
+      return *this;
+    }
+
+    constexpr iterator operator++(int) {
+      iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    constexpr bool operator==(const iterator &other) const {
+      return current_ == other.current_;
+    }
+
+  private:
+    constexpr void Parse(const char *pos) {
+      current_ = pos;
+      if (pos == nullptr) {
+        return;
+      }
+      value_ = 0;
+      while (pos < end_ && *pos != ';' && *pos != ':') {
+        if (*pos >= '0' && *pos <= '9' && value_ < 100000) {
+          value_ = value_ * 10 + static_cast<uint32_t>(*pos - '0');
+        }
+        ++pos;
+      }
+      next_ = pos < end_ ? pos + 1 : nullptr;
+    }
+
+    const char *current_ = nullptr; // Start of this value, null at end
+    const char *next_ = nullptr;    // Start of the next value
+    const char *end_ = nullptr;
+    uint32_t value_ = 0;
+  };
+
+  constexpr explicit SgrParameters(std::string_view parameters)
+      : parameters_(parameters) {}
+
+  constexpr iterator begin() const {
+    // A non-null start pointer is needed even for an empty parameter list
+    const char *start = parameters_.data() ? parameters_.data() : "";
+    return iterator(start, start + parameters_.size());
+  }
+
+  constexpr iterator end() const { return iterator(); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Number of values (always at least 1)
+  ///
+  ////////////////////////////////////////////////////////////
+  constexpr size_t size() const {
+    size_t count = 1;
+    for (char c : parameters_) {
+      count += (c == ';' || c == ':') ? 1 : 0;
+    }
+    return count;
+  }
+
+private:
+  std::string_view parameters_;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief One token of ANSI text: a text run or an escape sequence
+///
+/// All views point into the tokenized input.
+///
+////////////////////////////////////////////////////////////
+struct AnsiToken {
+  AnsiTokenKind kind = AnsiTokenKind::Text;
+  std::string_view text;          // Every byte of the token
+  std::string_view parameters;    // CSI parameter bytes (0x30-0x3F)
+  std::string_view intermediates; // CSI / nF intermediate bytes (0x20-0x2F)
+  char final_byte = '\0';         // CSI / escape final byte
+  bool complete = true; // False for unterminated or aborted sequences
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Parsed parameters of an Sgr token
+  ///
+  ////////////////////////////////////////////////////////////
+  constexpr SgrParameters sgr_parameters() const {
+    return SgrParameters(parameters);
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether the token is an escape sequence
+  ///
+  ////////////////////////////////////////////////////////////
+  constexpr bool is_escape() const { return kind != AnsiTokenKind::Text; }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Scan the token at the start of a string
+///
+/// This is the grammar shared by every escape-aware function in conmat.
+/// Sequences aborted by a control byte end before that byte, which then
+/// starts the next token; the same holds for a line feed inside an OSC
+/// or DCS string.
+///
+/// \param text Non-empty input
+/// \return The first token of text
+///
+////////////////////////////////////////////////////////////
+constexpr AnsiToken ScanAnsiToken(std::string_view text) {
+  constexpr char ESC = '\033';
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  AnsiToken token;
+
+  auto finish = [&](const char *stop) {
+    token.text = std::string_view(begin, static_cast<size_t>(stop - begin));
+    return token;
+  };
+  auto in_range = [](const char *p, unsigned char low, unsigned char high) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    return c >= low && c <= high;
+  };
+
+  if (*begin != ESC) {
+    return finish(detail::FindEscape(begin, end));
+  }
+
+  const char *p = begin + 1;
+  token.kind = AnsiTokenKind::Other;
+  if (p == end) {
+    token.complete = false;
+    return finish(p);
+  }
+
+  if (*p == '[') {
+    // CSI: parameters, intermediates, final byte
+    token.kind = AnsiTokenKind::Csi;
+    const char *parameters = ++p;
+    while (p < end && in_range(p, 0x30, 0x3F)) {
+      ++p;
+    }
+    const char *intermediates = p;
+    bool malformed = false;
+    while (p < end && in_range(p, 0x20, 0x3F)) {
+      // Parameter bytes after an intermediate are consumed but malformed
+      malformed = malformed || in_range(p, 0x30, 0x3F);
+      ++p;
+    }
+    token.parameters = std::string_view(
+        parameters, static_cast<size_t>(intermediates - parameters));
+    token.intermediates =
+        std::string_view(intermediates, static_cast<size_t>(p - intermediates));
+    if (p == end || !in_range(p, 0x40, 0x7E)) {
+      token.complete = false;
+      return finish(p);
+    }
+    token.final_byte = *p;
+    bool is_sgr = *p == 'm' && !malformed && token.intermediates.empty() &&
+                  static_cast<size_t>(p - parameters) <= kMaxAnsiParameterBytes;
+    for (char c : token.parameters) {
+      is_sgr = is_sgr && ((c >= '0' && c <= '9') || c == ';' || c == ':');
+    }
+    if (is_sgr) {
+      token.kind = AnsiTokenKind::Sgr;
+    }
+    return finish(p + 1);
+  }
+
+  if (*p == ']' || *p == 'P' || *p == 'X' || *p == '^' || *p == '_') {
+    // String sequence terminated by BEL or ST (ESC '\')
+    if (*p == ']') {
+      token.kind = AnsiTokenKind::Osc;
+    }
+    for (++p; p < end; ++p) {
+      if (*p == '\a') {
+        return finish(p + 1);
+      }
+      if (*p == ESC) {
+        if (p + 1 < end && p[1] == '\\') {
+          return finish(p + 2);
+        }
+        // A new sequence starts here (or the input ends mid terminator)
+        token.complete = false;
+        return finish(p + 1 == end ? end : p);
+      }
+      if (*p == '\n') {
+        break;
+      }
+    }
+    token.complete = false;
+    return finish(p);
+  }
+
+  if (in_range(p, 0x20, 0x2F)) {
+    // nF escape: intermediates then a final byte
+    const char *intermediates = p;
+    while (p < end && in_range(p, 0x20, 0x2F)) {
+      ++p;
+    }
+    token.intermediates =
+        std::string_view(intermediates, static_cast<size_t>(p - intermediates));
+    if (p == end || !in_range(p, 0x30, 0x7E)) {
+      token.complete = false;
+      return finish(p);
+    }
+    token.final_byte = *p;
+    return finish(p + 1);
+  }
+
+  if (in_range(p, 0x30, 0x7E)) {
+    token.final_byte = *p;
+    return finish(p + 1);
+  }
+
+  // Lone ESC: the following byte starts the next token
+  token.complete = false;
+  return finish(p);
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Zero-copy forward range over the tokens of ANSI text
+///
+/// Splits text into Text runs and escape sequence tokens without
+/// allocating. Text runs are located with a vectorized ESC search.
+/// Usable in constant expressions.
+///
+/// \example
+/// for (const AnsiToken &token : AnsiTokenizer(text)) {
+///   if (token.kind == AnsiTokenKind::Text) {
+///     out.append(token.text);
+///   }
+/// }
+///
+////////////////////////////////////////////////////////////
+class AnsiTokenizer {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = AnsiToken;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const AnsiToken *;
+    using reference = const AnsiToken &;
+
+    constexpr iterator() = default;
+    constexpr iterator(const char *pos, const char *end)
+        : pos_(pos), end_(end) {
+      Scan();
+    }
+
+    constexpr const AnsiToken &operator*() const { return token_; }
+    constexpr const AnsiToken *operator->() const { return &token_; }
+
+    constexpr iterator &operator++() {
+      pos_ += token_.text.size();
+      Scan();
+      return *this;
+    }
+
+    constexpr iterator operator++(int) {
+      iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    constexpr bool operator==(const iterator &other) const {
+      return pos_ == other.pos_;
+    }
+
+    constexpr bool operator==(std::default_sentinel_t) const {
+      return pos_ == end_;
+    }
+
+  private:
+    constexpr void Scan() {
+      if (pos_ != end_) {
+        token_ = ScanAnsiToken(
+            std::string_view(pos_, static_cast<size_t>(end_ - pos_)));
+      }
+    }
+
+    const char *pos_ = nullptr;
+    const char *end_ = nullptr;
+    AnsiToken token_;
+  };
+
+  constexpr explicit AnsiTokenizer(std::string_view text) : text_(text) {}
+
+  constexpr iterator begin() const {
+    return iterator(text_.data(), text_.data() + text_.size());
+  }
+
+  constexpr std::default_sentinel_t end() const { return {}; }
+
+private:
+  std::string_view text_;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Resumable ECMA-48 escape sequence parser for chunked input
+///
+/// Feed() may be called with arbitrarily split chunks; a sequence cut at
+/// a chunk boundary is completed by the next call. Plain text runs are
+/// reported through Handler::OnText and complete sequences through
+/// Handler::OnSequence. Incomplete or malformed sequences are dropped.
+///
+/// A line feed always returns the parser to the ground state, so the
+/// output never depends on where the input was split at line boundaries.
+///
+/// Sequences are classified exactly as AnsiTokenizer does for complete
+/// input; use the tokenizer when the whole text is in memory.
+///
+/// \example
+/// struct Handler {
+///   void OnText(std::string_view text);
+///   void OnSequence(const AnsiSequence &sequence);
+/// };
+///
+////////////////////////////////////////////////////////////
+class AnsiStreamParser {
+public:
+  /// \brief Maximum number of CSI parameter/intermediate bytes retained
+  static constexpr size_t kMaxParameterBytes = kMaxAnsiParameterBytes;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Parse the next chunk of input
+  /// \param chunk The bytes to parse
+  /// \param handler Receiver for text runs and complete sequences
+  ///
+  ////////////////////////////////////////////////////////////
+  template <typename Handler>
+  void Feed(std::string_view chunk, Handler &handler);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Drop any partially parsed sequence and return to ground state
+  ///
+  ////////////////////////////////////////////////////////////
+  void Reset() { BeginSequence(State::Ground); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether the parser is in the middle of a sequence
+  ///
+  ////////////////////////////////////////////////////////////
+  bool InSequence() const { return state_ != State::Ground; }
+
+private:
+  enum class State {
+    Ground,
+    Escape,
+    EscapeIntermediate,
+    Csi,
+    String,
+    StringEscape
+  };
+
+  void Record(char c) {
+    if (parameter_length_ < kMaxParameterBytes) {
+      parameters_[parameter_length_++] = c;
+    } else {
+      malformed_ = true;
+    }
+  }
+
+  template <typename Handler>
+  void Complete(AnsiSequenceType type, char final_byte, Handler &handler) {
+    AnsiSequence sequence;
+    sequence.type = type;
+    sequence.parameters = std::string_view(parameters_, intermediate_start_);
+    sequence.intermediates =
+        std::string_view(parameters_ + intermediate_start_,
+                         parameter_length_ - intermediate_start_);
+    sequence.final_byte = final_byte;
+    sequence.malformed = malformed_;
+    handler.OnSequence(sequence);
+    state_ = State::Ground;
+  }
+
+  void BeginSequence(State state) {
+    state_ = state;
+    parameter_length_ = 0;
+    intermediate_start_ = 0;
+    malformed_ = false;
+    string_is_osc_ = false;
+  }
+
+  State state_ = State::Ground;
+  char parameters_[kMaxParameterBytes] = {};
+  size_t parameter_length_ = 0;
+  size_t intermediate_start_ = 0;
+  bool malformed_ = false;
+  bool string_is_osc_ = false;
+};
+
+template <typename Handler>
+void AnsiStreamParser::Feed(std::string_view chunk, Handler &handler) {
+  constexpr char ESC = '\033';
+  const char *pos = chunk.data();
+  const char *end = pos + chunk.size();
+
+  while (pos < end) {
+    if (state_ == State::Ground) {
+      // Fast path: hand over everything up to the next ESC in one run
+      const char *esc = detail::FindEscape(pos, end);
+      if (esc != pos) {
+        handler.OnText(std::string_view(pos, static_cast<size_t>(esc - pos)));
+      }
+      if (esc == end) {
+        return;
+      }
+      BeginSequence(State::Escape);
+      pos = esc + 1;
+      continue;
+    }
+
+    const unsigned char byte = static_cast<unsigned char>(*pos);
+
+    switch (state_) {
+    case State::Ground:
+      break;
+
+    case State::Escape:
+      if (byte == '[') {
+        state_ = State::Csi;
+      } else if (byte == ']') {
+        state_ = State::String;
+        string_is_osc_ = true;
+      } else if (byte == 'P' || byte == 'X' || byte == '^' || byte == '_') {
+        state_ = State::String;
+      } else if (byte >= 0x20 && byte <= 0x2F) {
+        Record(static_cast<char>(byte));
+        state_ = State::EscapeIntermediate;
+      } else if (byte >= 0x30 && byte <= 0x7E) {
+        Complete(AnsiSequenceType::Other, static_cast<char>(byte), handler);
+      } else if (byte == static_cast<unsigned char>(ESC)) {
+        BeginSequence(State::Escape);
+      } else {
+        // Lone ESC: drop it and treat the byte as text
+        state_ = State::Ground;
+        continue;
+      }
+      break;
+
+    case State::EscapeIntermediate:
+      if (byte >= 0x20 && byte <= 0x2F) {
+        Record(static_cast<char>(byte));
+      } else if (byte >= 0x30 && byte <= 0x7E) {
+        Complete(AnsiSequenceType::Other, static_cast<char>(byte), handler);
+      } else if (byte == static_cast<unsigned char>(ESC)) {
+        BeginSequence(State::Escape);
+      } else {
+        state_ = State::Ground;
+        continue;
+      }
+      break;
+
+    case State::Csi:
+      if (byte >= 0x30 && byte <= 0x3F) {
+        // Parameter bytes are not allowed after intermediates
+        if (intermediate_start_ != parameter_length_) {
+          malformed_ = true;
+        }
+        Record(static_cast<char>(byte));
+        if (!malformed_) {
+          intermediate_start_ = parameter_length_;
+        }
+      } else if (byte >= 0x20 && byte <= 0x2F) {
+        Record(static_cast<char>(byte));
+      } else if (byte >= 0x40 && byte <= 0x7E) {
+        bool is_sgr = byte == 'm' && !malformed_ &&
+                      intermediate_start_ == parameter_length_;
+        for (size_t i = 0; is_sgr && i < intermediate_start_; ++i) {
+          char c = parameters_[i];
+          is_sgr = (c >= '0' && c <= '9') || c == ';' || c == ':';
+        }
+        Complete(is_sgr ? AnsiSequenceType::Sgr : AnsiSequenceType::Csi,
+                 static_cast<char>(byte), handler);
+      } else if (byte == static_cast<unsigned char>(ESC)) {
+        BeginSequence(State::Escape);
+      } else {
+        // Control or 8-bit byte inside CSI: abort and reprocess as text
+        state_ = State::Ground;
+        continue;
+      }
+      break;
+
+    case State::String:
+      if (byte == '\a') {
+        Complete(string_is_osc_ ? AnsiSequenceType::Osc
+                                : AnsiSequenceType::Other,
+                 '\a', handler);
+      } else if (byte == static_cast<unsigned char>(ESC)) {
+        state_ = State::StringEscape;
+      } else if (byte == '\n') {
+        state_ = State::Ground;
+        continue;
+      }
+      break;
+
+    case State::StringEscape:
+      if (byte == '\\') {
+        Complete(string_is_osc_ ? AnsiSequenceType::Osc
+                                : AnsiSequenceType::Other,
+                 '\\', handler);
+      } else {
+        // Unterminated string followed by a new escape sequence
+        BeginSequence(State::Escape);
+        continue;
+      }
+      break;
+    }
+    ++pos;
+  }
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Color selected by an SGR sequence
+///
+/// Basic (30-37), bright (90-97) and 256-color (38;5;n) selections are
+/// stored as a palette index, 24-bit selections (38;2;r;g;b) as RGB.
+///
+////////////////////////////////////////////////////////////
+struct SgrColor {
+  enum class Kind : uint8_t { Default, Indexed, Rgb };
+
+  Kind kind = Kind::Default;
+  uint8_t index = 0; // Palette index for Kind::Indexed
+  uint8_t red = 0;   // Components for Kind::Rgb
+  uint8_t green = 0;
+  uint8_t blue = 0;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Map to the nearest of the 16 basic terminal colors
+  /// \return Palette index 0-15, or -1 for the default color
+  ///
+  ////////////////////////////////////////////////////////////
+  int BasicIndex() const;
+
+  bool operator==(const SgrColor &) const = default;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Text attribute bits tracked by SgrState
+///
+/// Bit n corresponds to Style value n + 1, so a Style maps to its bit
+/// with `1u << (static_cast<int>(style) - 1)`.
+///
+////////////////////////////////////////////////////////////
+namespace sgr_attribute {
+inline constexpr uint16_t Bold = 1u << 0;
+inline constexpr uint16_t Dim = 1u << 1;
+inline constexpr uint16_t Italic = 1u << 2;
+inline constexpr uint16_t Underline = 1u << 3;
+inline constexpr uint16_t Blink = 1u << 4;
+inline constexpr uint16_t Reverse = 1u << 5;
+inline constexpr uint16_t Hidden = 1u << 6;
+inline constexpr uint16_t Strikethrough = 1u << 7;
+} // namespace sgr_attribute
+
+////////////////////////////////////////////////////////////
+/// \brief Graphic rendition state accumulated from SGR sequences
+///
+/// \example
+/// SgrState state;
+/// state.Apply("1;31");   // bold red
+/// state.Apply("22");     // red
+/// state.Apply("");       // reset (ESC [ m)
+///
+////////////////////////////////////////////////////////////
+struct SgrState {
+  SgrColor foreground;
+  SgrColor background;
+  uint16_t attributes = 0; // sgr_attribute bits
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Apply the parameters of one SGR sequence
+  /// \param parameters Parameter bytes between "ESC [" and 'm'
+  ///
+  ////////////////////////////////////////////////////////////
+  void Apply(std::string_view parameters);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether no color or attribute is active
+  ///
+  ////////////////////////////////////////////////////////////
+  bool IsDefault() const {
+    return attributes == 0 && foreground.kind == SgrColor::Kind::Default &&
+           background.kind == SgrColor::Kind::Default;
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append one SGR sequence that sets this state from default
+  /// \param out String the sequence is appended to (nothing if default)
+  ///
+  ////////////////////////////////////////////////////////////
+  void AppendTo(std::string &out) const;
+
+  bool operator==(const SgrState &) const = default;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming ANSI escape sequence remover
+///
+/// Removes CSI, OSC, DCS and other escape sequences from input fed in
+/// arbitrary chunks. All other bytes are passed through unchanged.
+///
+/// \example
+/// AnsiStripper stripper;
+/// std::string out;
+/// stripper.Feed("\033[3", out);
+/// stripper.Feed("1mred\033[0m", out);  // out == "red"
+///
+////////////////////////////////////////////////////////////
+class AnsiStripper {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Strip the next chunk of input
+  /// \param chunk The bytes to strip
+  /// \param out String the stripped text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Feed(std::string_view chunk, std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Drop any partially parsed sequence
+  ///
+  ////////////////////////////////////////////////////////////
+  void Reset() { parser_.Reset(); }
+
+private:
+  AnsiStreamParser parser_;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Which SGR sequences SgrSanitizer lets through
+///
+////////////////////////////////////////////////////////////
+enum class SgrPolicy : uint8_t {
+  Any,  // every well-formed SGR sequence, unchanged
+  Basic // only conmat's Color/Style set; other colors map to the nearest
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming sanitizer that keeps colors and styles
+///
+/// Intended for relaying output of trusted tools such as compilers and
+/// test runners. Well-formed SGR sequences are kept; cursor movement,
+/// OSC (titles, hyperlinks), other escape sequences, malformed or
+/// unterminated sequences and control characters are removed as by
+/// Sanitize(). Input is parsed in one pass by AnsiStreamParser, so text
+/// runs are copied in bulk and chunks may split sequences anywhere.
+///
+/// With SgrPolicy::Basic each kept sequence is replaced by one that sets
+/// the same state restricted to the 16 basic colors and the Style
+/// attributes; 256-color and RGB selections map to the nearest basic
+/// color and unknown codes are dropped.
+///
+/// Finish() appends a reset if the input left attributes active.
+///
+/// \example
+/// SgrSanitizer sanitizer;
+/// std::string out;
+/// sanitizer.Feed("\033[1;31merror\033[2A\033]0;title\a", out);
+/// sanitizer.Finish(out);  // out == "\033[1;31merror\033[0m"
+///
+////////////////////////////////////////////////////////////
+class SgrSanitizer {
+public:
+  explicit SgrSanitizer(SgrPolicy policy = SgrPolicy::Any)
+      : policy_(policy) {}
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Sanitize the next chunk of input
+  /// \param chunk The bytes to sanitize
+  /// \param out String the sanitized text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Feed(std::string_view chunk, std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief End the input
+  ///
+  /// Drops a partially parsed sequence, appends a reset if attributes
+  /// are still active and prepares the sanitizer for new input.
+  ///
+  /// \param out String the reset is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Finish(std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief State set by the sequences passed through so far
+  ///
+  ////////////////////////////////////////////////////////////
+  const SgrState &state() const { return emitted_; }
+
+private:
+  struct Handler;
+
+  AnsiStreamParser parser_;
+  SgrState input_;         // State set by the input
+  SgrState emitted_;       // State set by the output
+  bool untracked_ = false; // Output set codes SgrState does not model
+  SgrPolicy policy_;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Sanitize text, keeping SGR sequences
+///
+/// Equivalent to feeding the whole text to an SgrSanitizer and calling
+/// Finish().
+///
+/// \param text The text to sanitize
+/// \param policy Which SGR sequences to keep
+/// \return Sanitized text, reset at the end if styles were left active
+///
+////////////////////////////////////////////////////////////
+std::string SanitizeSgr(std::string_view text,
+                        SgrPolicy policy = SgrPolicy::Any);
+
+} // namespace conmat
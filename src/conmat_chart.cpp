@@ -0,0 +1,241 @@
+#include "conmat_chart.h"
+#include "conmat_codes.h"
+#include "conmat_stats_scope.h"
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <vector>
+
+namespace conmat {
+
+namespace {
+
+// Sparkline levels, lowest first
+constexpr std::string_view kLevelGlyphs[8] = {"▁", "▂", "▃", "▄",
+                                              "▅", "▆", "▇", "█"};
+
+constexpr size_t kLevelGlyphSize = 3; // UTF-8 bytes of every level glyph
+
+// Partial bar cells, one to seven eighths
+constexpr std::string_view kEighthGlyphs[7] = {"▏", "▎", "▍", "▌",
+                                               "▋", "▊", "▉"};
+
+constexpr std::string_view kFullBlock = "█";
+
+// Independent accumulators keep the loop free of cross-iteration
+// dependencies, so it compiles to packed min/max/add
+constexpr size_t kLanes = 4;
+
+SeriesBucket Summarize(const double *samples, size_t count) {
+  double low[kLanes];
+  double high[kLanes];
+  double sum[kLanes] = {};
+  for (size_t lane = 0; lane < kLanes; ++lane) {
+    low[lane] = samples[0];
+    high[lane] = samples[0];
+  }
+
+  size_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      double value = samples[i + lane];
+      low[lane] = value < low[lane] ? value : low[lane];
+      high[lane] = value > high[lane] ? value : high[lane];
+      sum[lane] += value;
+    }
+  }
+  for (; i < count; ++i) {
+    double value = samples[i];
+    low[0] = value < low[0] ? value : low[0];
+    high[0] = value > high[0] ? value : high[0];
+    sum[0] += value;
+  }
+
+  SeriesBucket bucket{low[0], high[0], sum[0]};
+  for (size_t lane = 1; lane < kLanes; ++lane) {
+    bucket.min = std::min(bucket.min, low[lane]);
+    bucket.max = std::max(bucket.max, high[lane]);
+    bucket.mean += sum[lane];
+  }
+  bucket.mean /= static_cast<double>(count);
+  return bucket;
+}
+
+double BucketValue(const SeriesBucket &bucket, SparklineValue value) {
+  switch (value) {
+  case SparklineValue::Mean:
+    return bucket.mean;
+  case SparklineValue::Min:
+    return bucket.min;
+  case SparklineValue::Max:
+    break;
+  }
+  return bucket.max;
+}
+
+} // anonymous namespace
+
+size_t Downsample(std::span<const double> samples,
+                  std::span<SeriesBucket> buckets) {
+  size_t count = std::min(samples.size(), buckets.size());
+  size_t begin = 0;
+  for (size_t i = 0; i < count; ++i) {
+    size_t end = (i + 1) * samples.size() / count;
+    buckets[i] = Summarize(samples.data() + begin, end - begin);
+    begin = end;
+  }
+  return count;
+}
+
+void SparklineTo(std::string &out, std::span<const double> samples,
+                 const SparklineOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::Chart, samples.size() * sizeof(double));
+  [[maybe_unused]] size_t start = out.size();
+
+  // Column values, then their levels. The width is bounded, so they
+  // live on the stack; buckets match Downsample().
+  size_t columns =
+      std::min({options.width, samples.size(), kMaxSparklineWidth});
+  if (columns == 0) {
+    return;
+  }
+  double values[kMaxSparklineWidth];
+  size_t begin = 0;
+  for (size_t i = 0; i < columns; ++i) {
+    size_t end = (i + 1) * samples.size() / columns;
+    values[i] = BucketValue(Summarize(samples.data() + begin, end - begin),
+                            options.value);
+    begin = end;
+  }
+
+  double low = options.low;
+  double high = options.high;
+  if (!(low < high)) {
+    low = values[0];
+    high = low;
+    for (size_t i = 1; i < columns; ++i) {
+      low = std::min(low, values[i]);
+      high = std::max(high, values[i]);
+    }
+  }
+
+  double scale = high > low ? 7.0 / (high - low) : 0.0;
+  for (size_t i = 0; i < columns; ++i) {
+    values[i] = std::clamp(std::round((values[i] - low) * scale), 0.0, 7.0);
+  }
+
+  if (options.colors.empty()) {
+    for (size_t i = 0; i < columns; ++i) {
+      out.append(kLevelGlyphs[static_cast<size_t>(values[i])]);
+    }
+  } else {
+    char glyphs[kMaxSparklineWidth * kLevelGlyphSize];
+    for (size_t i = 0; i < columns; ++i) {
+      std::string_view glyph = kLevelGlyphs[static_cast<size_t>(values[i])];
+      std::copy(glyph.begin(), glyph.end(), glyphs + i * kLevelGlyphSize);
+    }
+    ColorCharactersTo(
+        out, std::string_view(glyphs, columns * kLevelGlyphSize),
+        [&](size_t index) {
+          return GradientColor(options.colors, values[index] / 7.0);
+        },
+        options.depth);
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+std::string Sparkline(std::span<const double> samples,
+                      const SparklineOptions &options) {
+  std::string result;
+  SparklineTo(result, samples, options);
+  return result;
+}
+
+void BarTo(std::string &out, double fraction, size_t width,
+           const FormatOptions &options) {
+  if (!(fraction > 0.0)) {
+    fraction = 0.0;
+  }
+  size_t eighths = static_cast<size_t>(
+      std::lround(std::min(fraction, 1.0) * static_cast<double>(width) * 8));
+  size_t full = eighths / 8;
+  size_t partial = eighths % 8;
+
+  if (eighths != 0) {
+    bool plain = options.foreground == Color::Default &&
+                 options.background == Color::Default &&
+                 options.style == Style::Default;
+    if (!plain) {
+      // Codes only; the glyphs are sanitization-safe and go in directly
+      FormatOptions codes = options;
+      codes.reset_after = false;
+      FormatTo(out, "", codes);
+    }
+    for (size_t i = 0; i < full; ++i) {
+      out.append(kFullBlock);
+    }
+    if (partial != 0) {
+      out.append(kEighthGlyphs[partial - 1]);
+    }
+    if (!plain && options.reset_after) {
+      out.append(detail::RESET);
+    }
+  }
+  out.append(width - full - (partial != 0), ' ');
+}
+
+void HistogramTo(std::string &out, std::span<const double> samples,
+                 const HistogramOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::Chart, samples.size() * sizeof(double));
+  [[maybe_unused]] size_t start = out.size();
+  if (samples.empty() || options.bins == 0) {
+    return;
+  }
+
+  SeriesBucket range;
+  Downsample(samples, std::span(&range, 1));
+  size_t bins = range.max > range.min ? options.bins : 1;
+  double bin_width = (range.max - range.min) / static_cast<double>(bins);
+
+  std::vector<size_t> counts(bins);
+  double scale = bin_width > 0.0 ? 1.0 / bin_width : 0.0;
+  for (double value : samples) {
+    size_t bin = static_cast<size_t>((value - range.min) * scale);
+    ++counts[std::min(bin, bins - 1)];
+  }
+  size_t most = *std::max_element(counts.begin(), counts.end());
+
+  // Right-align the lower bounds
+  std::vector<std::string> labels(bins);
+  size_t label_width = 0;
+  for (size_t i = 0; i < bins; ++i) {
+    char buffer[detail::kNumberBufferSize];
+    labels[i] = detail::NumberToText(
+        buffer, range.min + bin_width * static_cast<double>(i));
+    label_width = std::max(label_width, labels[i].size());
+  }
+
+  for (size_t i = 0; i < bins; ++i) {
+    char buffer[detail::kNumberBufferSize];
+    out.append(label_width - labels[i].size(), ' ');
+    out.append(labels[i]);
+    out.append(" │");
+    BarTo(out,
+          static_cast<double>(counts[i]) / static_cast<double>(most),
+          options.width, options.bar);
+    out.append("│ ");
+    out.append(detail::NumberToText(
+        buffer, static_cast<unsigned long long>(counts[i])));
+    out.push_back('\n');
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+std::string Histogram(std::span<const double> samples,
+                      const HistogramOptions &options) {
+  std::string result;
+  HistogramTo(result, samples, options);
+  return result;
+}
+
+} // namespace conmat
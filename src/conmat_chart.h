@@ -0,0 +1,151 @@
+#pragma once
+
+#include "conmat.h"
+#include "conmat_gradient.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Minimum, maximum and mean of a range of samples
+///
+////////////////////////////////////////////////////////////
+struct SeriesBucket {
+  double min = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Reduce a series to equal-sized buckets in a single pass
+///
+/// Bucket i summarizes samples [i * n / k, (i + 1) * n / k) for n
+/// samples and k buckets. Each bucket is scanned once with independent
+/// accumulators so the loop vectorizes; nothing is allocated. Buckets
+/// past the number of samples are left untouched.
+///
+/// \param samples Finite sample values
+/// \param buckets Buckets to fill
+/// \return Number of buckets filled, min(samples.size(), buckets.size())
+///
+////////////////////////////////////////////////////////////
+size_t Downsample(std::span<const double> samples,
+                  std::span<SeriesBucket> buckets);
+
+////////////////////////////////////////////////////////////
+/// \brief Bucket statistic a sparkline column shows
+///
+////////////////////////////////////////////////////////////
+enum class SparklineValue : uint8_t {
+  Max, // Spikes stay visible (latency)
+  Mean,
+  Min
+};
+
+/// \brief Most columns a sparkline is drawn with
+inline constexpr size_t kMaxSparklineWidth = 512;
+
+////////////////////////////////////////////////////////////
+/// \brief Options for Sparkline()
+///
+////////////////////////////////////////////////////////////
+struct SparklineOptions {
+  size_t width = 80; // Maximum number of columns, up to kMaxSparklineWidth
+  SparklineValue value = SparklineValue::Max;
+  double low = 0.0;  // Value of the lowest bar; scaled to the data
+  double high = 0.0; // unless low < high
+  std::span<const SgrColor> colors; // Gradient by bar height, empty for none
+  ColorDepth depth = ColorDepth::TrueColor;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Append a sparkline of a series
+///
+/// The series is downsampled to at most options.width columns with
+/// Downsample() and each column is drawn as one of the eight block
+/// glyphs "▁▂▃▄▅▆▇█". With colors set, bars are colored by height and
+/// equal neighbours share one escape sequence (see ColorCharactersTo()).
+/// Cost is one pass over the samples plus work per column; nothing is
+/// allocated but the growth of out.
+///
+/// \param out String the sparkline is appended to
+/// \param samples Finite sample values
+/// \param options Width, statistic, scale and colors
+///
+/// \example
+/// std::string row = "p99 ";
+/// SparklineTo(row, latencies, {.width = 40});
+///
+////////////////////////////////////////////////////////////
+void SparklineTo(std::string &out, std::span<const double> samples,
+                 const SparklineOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Render a sparkline of a series
+/// \return The sparkline, empty for an empty series
+///
+////////////////////////////////////////////////////////////
+std::string Sparkline(std::span<const double> samples,
+                      const SparklineOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Append a horizontal bar with eighth-column resolution
+///
+/// The bar is padded with spaces to exactly width columns so text after
+/// it lines up across rows.
+///
+/// \param out String the bar is appended to
+/// \param fraction Filled part of the bar, clamped to [0, 1]
+/// \param width Bar width in columns
+/// \param options Formatting of the filled part
+///
+/// \example
+/// BarTo(row, used / total, 20, {Color::Green});  // "█████████▌          "
+///
+////////////////////////////////////////////////////////////
+void BarTo(std::string &out, double fraction, size_t width,
+           const FormatOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Options for Histogram()
+///
+////////////////////////////////////////////////////////////
+struct HistogramOptions {
+  size_t bins = 10;          // Number of rows
+  size_t width = 40;         // Width of the longest bar
+  FormatOptions bar{Color::Cyan};
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Append a horizontal histogram of a series
+///
+/// Samples are counted into equal-width bins between the smallest and
+/// largest sample. Each bin is one line: its lower bound, a bar scaled
+/// to the fullest bin and the count.
+///
+/// \param out String the histogram is appended to
+/// \param samples Finite sample values
+/// \param options Bin count, bar width and color
+///
+/// \example
+/// std::cout << Histogram(latencies, {.bins = 5, .width = 20});
+/// // 0.5 │████████▌           │ 17
+/// //   1 │████████████████████│ 40
+/// // ...
+///
+////////////////////////////////////////////////////////////
+void HistogramTo(std::string &out, std::span<const double> samples,
+                 const HistogramOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Render a horizontal histogram of a series
+/// \return The histogram, empty for an empty series
+///
+////////////////////////////////////////////////////////////
+std::string Histogram(std::span<const double> samples,
+                      const HistogramOptions &options = {});
+
+} // namespace conmat
@@ -0,0 +1,122 @@
+#pragma once
+
+// ANSI escape codes of the Color and Style enums, shared by the
+// formatting functions. Internal header, only included by conmat
+// sources.
+
+#include "conmat.h"
+#include <string_view>
+
+namespace conmat::detail {
+
+// Reset of every color and style
+inline constexpr std::string_view RESET = "\033[0m";
+
+// Get ANSI code for foreground color
+constexpr std::string_view get_fg_color_code(Color color) {
+  switch (color) {
+  case Color::Default:
+    return "";
+  case Color::Black:
+    return "\033[30m";
+  case Color::Red:
+    return "\033[31m";
+  case Color::Green:
+    return "\033[32m";
+  case Color::Yellow:
+    return "\033[33m";
+  case Color::Blue:
+    return "\033[34m";
+  case Color::Magenta:
+    return "\033[35m";
+  case Color::Cyan:
+    return "\033[36m";
+  case Color::White:
+    return "\033[37m";
+  case Color::BrightBlack:
+    return "\033[90m";
+  case Color::BrightRed:
+    return "\033[91m";
+  case Color::BrightGreen:
+    return "\033[92m";
+  case Color::BrightYellow:
+    return "\033[93m";
+  case Color::BrightBlue:
+    return "\033[94m";
+  case Color::BrightMagenta:
+    return "\033[95m";
+  case Color::BrightCyan:
+    return "\033[96m";
+  case Color::BrightWhite:
+    return "\033[97m";
+  }
+  return "";
+}
+
+// Get ANSI code for background color
+constexpr std::string_view get_bg_color_code(Color color) {
+  switch (color) {
+  case Color::Default:
+    return "";
+  case Color::Black:
+    return "\033[40m";
+  case Color::Red:
+    return "\033[41m";
+  case Color::Green:
+    return "\033[42m";
+  case Color::Yellow:
+    return "\033[43m";
+  case Color::Blue:
+    return "\033[44m";
+  case Color::Magenta:
+    return "\033[45m";
+  case Color::Cyan:
+    return "\033[46m";
+  case Color::White:
+    return "\033[47m";
+  case Color::BrightBlack:
+    return "\033[100m";
+  case Color::BrightRed:
+    return "\033[101m";
+  case Color::BrightGreen:
+    return "\033[102m";
+  case Color::BrightYellow:
+    return "\033[103m";
+  case Color::BrightBlue:
+    return "\033[104m";
+  case Color::BrightMagenta:
+    return "\033[105m";
+  case Color::BrightCyan:
+    return "\033[106m";
+  case Color::BrightWhite:
+    return "\033[107m";
+  }
+  return "";
+}
+
+// Get ANSI code for text style
+constexpr std::string_view get_style_code(Style style) {
+  switch (style) {
+  case Style::Default:
+    return "";
+  case Style::Bold:
+    return "\033[1m";
+  case Style::Dim:
+    return "\033[2m";
+  case Style::Italic:
+    return "\033[3m";
+  case Style::Underline:
+    return "\033[4m";
+  case Style::Blink:
+    return "\033[5m";
+  case Style::Reverse:
+    return "\033[7m";
+  case Style::Hidden:
+    return "\033[8m";
+  case Style::Strikethrough:
+    return "\033[9m";
+  }
+  return "";
+}
+
+} // namespace conmat::detail
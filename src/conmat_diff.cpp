@@ -0,0 +1,712 @@
+#include "conmat_diff.h"
+#include "conmat.h"
+#include "conmat_stats_scope.h"
+#include "conmat_text.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace conmat {
+
+namespace {
+
+// Longest line, in bytes, that is diffed character by character
+constexpr size_t kMaxInlineBytes = 4096;
+
+////////////////////////////////////////////////////////////
+/// Myers' O(ND) difference algorithm, linear-space variant ("An O(ND)
+/// Difference Algorithm and Its Variations", section 4b). Each call of
+/// Split() finds the middle snake of an edit path with a forward and a
+/// backward search, and the halves are compared recursively.
+///
+/// Like GNU diff, a search that runs for more than about sqrt(N + M)
+/// rounds settles for the furthest point reached so far, which bounds the
+/// run time on very different inputs at the cost of minimality.
+///
+/// equal(x, y) compares element x of the old sequence with element y of
+/// the new one. The result marks every element that is not part of the
+/// common subsequence.
+////////////////////////////////////////////////////////////
+template <typename Equal> class MyersDiff {
+public:
+  MyersDiff(size_t old_size, size_t new_size, Equal equal)
+      : deleted(old_size, 0), inserted(new_size, 0), equal_(equal),
+        offset_(static_cast<ptrdiff_t>(new_size) + 1),
+        forward_(old_size + new_size + 3),
+        backward_(old_size + new_size + 3) {
+    too_expensive_ = 1;
+    for (size_t diagonals = old_size + new_size + 3; diagonals != 0;
+         diagonals >>= 2) {
+      too_expensive_ <<= 1;
+    }
+    too_expensive_ = std::max<ptrdiff_t>(too_expensive_, 256);
+    Compare(0, static_cast<ptrdiff_t>(old_size), 0,
+            static_cast<ptrdiff_t>(new_size));
+  }
+
+  std::vector<uint8_t> deleted;  // Old elements missing from the new
+  std::vector<uint8_t> inserted; // New elements missing from the old
+
+private:
+  ptrdiff_t &Forward(ptrdiff_t diagonal) {
+    return forward_[static_cast<size_t>(diagonal + offset_)];
+  }
+  ptrdiff_t &Backward(ptrdiff_t diagonal) {
+    return backward_[static_cast<size_t>(diagonal + offset_)];
+  }
+
+  void Compare(ptrdiff_t xoff, ptrdiff_t xlim, ptrdiff_t yoff,
+               ptrdiff_t ylim) {
+    // Common prefix and suffix are matched without searching
+    while (xoff < xlim && yoff < ylim && equal_(xoff, yoff)) {
+      ++xoff;
+      ++yoff;
+    }
+    while (xoff < xlim && yoff < ylim && equal_(xlim - 1, ylim - 1)) {
+      --xlim;
+      --ylim;
+    }
+
+    if (xoff == xlim) {
+      std::fill(inserted.begin() + yoff, inserted.begin() + ylim, 1);
+    } else if (yoff == ylim) {
+      std::fill(deleted.begin() + xoff, deleted.begin() + xlim, 1);
+    } else {
+      auto [xmid, ymid] = Split(xoff, xlim, yoff, ylim);
+      Compare(xoff, xmid, yoff, ymid);
+      Compare(xmid, xlim, ymid, ylim);
+    }
+  }
+
+  // Diagonals are numbered x - y in absolute coordinates
+  std::pair<ptrdiff_t, ptrdiff_t> Split(ptrdiff_t xoff, ptrdiff_t xlim,
+                                        ptrdiff_t yoff, ptrdiff_t ylim) {
+    const ptrdiff_t dmin = xoff - ylim;
+    const ptrdiff_t dmax = xlim - yoff;
+    const ptrdiff_t fmid = xoff - yoff;
+    const ptrdiff_t bmid = xlim - ylim;
+    const bool odd = ((fmid - bmid) & 1) != 0;
+    ptrdiff_t fmin = fmid, fmax = fmid;
+    ptrdiff_t bmin = bmid, bmax = bmid;
+    Forward(fmid) = xoff;
+    Backward(bmid) = xlim;
+
+    for (ptrdiff_t cost = 1;; ++cost) {
+      // Extend the forward search by one edit
+      if (fmin > dmin) {
+        Forward(--fmin - 1) = -1;
+      } else {
+        ++fmin;
+      }
+      if (fmax < dmax) {
+        Forward(++fmax + 1) = -1;
+      } else {
+        --fmax;
+      }
+      for (ptrdiff_t d = fmax; d >= fmin; d -= 2) {
+        ptrdiff_t low = Forward(d - 1);
+        ptrdiff_t high = Forward(d + 1);
+        ptrdiff_t x = low < high ? high : low + 1;
+        ptrdiff_t y = x - d;
+        while (x < xlim && y < ylim && equal_(x, y)) {
+          ++x;
+          ++y;
+        }
+        Forward(d) = x;
+        if (odd && bmin <= d && d <= bmax && Backward(d) <= x) {
+          return {x, y};
+        }
+      }
+
+      // Extend the backward search by one edit
+      if (bmin > dmin) {
+        Backward(--bmin - 1) = std::numeric_limits<ptrdiff_t>::max();
+      } else {
+        ++bmin;
+      }
+      if (bmax < dmax) {
+        Backward(++bmax + 1) = std::numeric_limits<ptrdiff_t>::max();
+      } else {
+        --bmax;
+      }
+      for (ptrdiff_t d = bmax; d >= bmin; d -= 2) {
+        ptrdiff_t low = Backward(d - 1);
+        ptrdiff_t high = Backward(d + 1);
+        ptrdiff_t x = low < high ? low : high - 1;
+        ptrdiff_t y = x - d;
+        while (xoff < x && yoff < y && equal_(x - 1, y - 1)) {
+          --x;
+          --y;
+        }
+        Backward(d) = x;
+        if (!odd && fmin <= d && d <= fmax && x <= Forward(d)) {
+          return {x, y};
+        }
+      }
+
+      if (cost >= too_expensive_) {
+        return BestSplit(xoff, xlim, yoff, ylim, fmin, fmax, bmin, bmax);
+      }
+    }
+  }
+
+  // Split at whichever search got further from its corner
+  std::pair<ptrdiff_t, ptrdiff_t> BestSplit(ptrdiff_t xoff, ptrdiff_t xlim,
+                                            ptrdiff_t yoff, ptrdiff_t ylim,
+                                            ptrdiff_t fmin, ptrdiff_t fmax,
+                                            ptrdiff_t bmin, ptrdiff_t bmax) {
+    ptrdiff_t forward_best = -1;
+    ptrdiff_t forward_x = xoff;
+    for (ptrdiff_t d = fmax; d >= fmin; d -= 2) {
+      ptrdiff_t x = std::min(Forward(d), xlim);
+      ptrdiff_t y = x - d;
+      if (ylim < y) {
+        x = ylim + d;
+        y = ylim;
+      }
+      if (forward_best < x + y) {
+        forward_best = x + y;
+        forward_x = x;
+      }
+    }
+
+    ptrdiff_t backward_best = std::numeric_limits<ptrdiff_t>::max();
+    ptrdiff_t backward_x = xlim;
+    for (ptrdiff_t d = bmax; d >= bmin; d -= 2) {
+      ptrdiff_t x = std::max(xoff, Backward(d));
+      ptrdiff_t y = x - d;
+      if (y < yoff) {
+        x = yoff + d;
+        y = yoff;
+      }
+      if (x + y < backward_best) {
+        backward_best = x + y;
+        backward_x = x;
+      }
+    }
+
+    if ((xlim + ylim) - backward_best < forward_best - (xoff + yoff)) {
+      return {forward_x, forward_best - forward_x};
+    }
+    return {backward_x, backward_best - backward_x};
+  }
+
+  Equal equal_;
+  ptrdiff_t offset_;
+  ptrdiff_t too_expensive_;
+  std::vector<ptrdiff_t> forward_;
+  std::vector<ptrdiff_t> backward_;
+};
+
+std::vector<std::string_view> SplitLines(std::string_view text) {
+  std::vector<std::string_view> lines;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string_view::npos) {
+      end = text.size();
+    }
+    lines.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+  return lines;
+}
+
+void SplitCharacters(std::string_view line,
+                     std::vector<std::string_view> &characters) {
+  characters.clear();
+  const char *pos = line.data();
+  const char *end = pos + line.size();
+  while (pos < end) {
+    const char *start = pos;
+    detail::DecodeUtf8(pos, end);
+    characters.emplace_back(start, static_cast<size_t>(pos - start));
+  }
+}
+
+// Run of lines that is either common to both texts or changed
+struct Block {
+  bool equal;
+  size_t old_start;
+  size_t new_start;
+  size_t old_count;
+  size_t new_count;
+};
+
+// Character-level comparison of a changed line pair
+struct InlineDiff {
+  std::vector<std::string_view> old_characters;
+  std::vector<std::string_view> new_characters;
+  std::vector<uint8_t> old_changed;
+  std::vector<uint8_t> new_changed;
+  bool valid = false;
+};
+
+// One side of a rendered line: the text and optional character flags
+struct LineView {
+  std::string_view text;
+  const std::vector<std::string_view> *characters = nullptr;
+  const std::vector<uint8_t> *changed = nullptr;
+};
+
+class DiffRenderer {
+public:
+  DiffRenderer(const std::vector<std::string_view> &old_lines,
+               const std::vector<std::string_view> &new_lines,
+               bool old_unterminated, bool new_unterminated,
+               const DiffOptions &options, std::string &out)
+      : old_lines_(old_lines), new_lines_(new_lines),
+        old_unterminated_(old_unterminated),
+        new_unterminated_(new_unterminated), options_(options), out_(out) {
+    plain_.reset_after = false;
+    if (options.color) {
+      title_.style = Style::Bold;
+      hunk_.foreground = Color::Cyan;
+      deleted_.foreground = Color::Red;
+      inserted_.foreground = Color::Green;
+    } else {
+      title_ = hunk_ = deleted_ = inserted_ = plain_;
+    }
+    deleted_changed_ = deleted_;
+    inserted_changed_ = inserted_;
+    deleted_changed_.style = Style::Reverse;
+    inserted_changed_.style = Style::Reverse;
+    column_width_ = options.width > 3 ? (options.width - 3) / 2 : 1;
+  }
+
+  void Render(const std::vector<Block> &blocks) {
+    RenderTitle();
+    const size_t context = options_.context;
+    for (size_t first = 0; first < blocks.size(); ++first) {
+      if (blocks[first].equal) {
+        continue;
+      }
+      // Merge changes separated by at most twice the context
+      size_t last = first;
+      while (last + 2 < blocks.size() &&
+             blocks[last + 1].old_count <= 2 * context) {
+        last += 2;
+      }
+      size_t lead = first > 0 ? std::min(context, blocks[first - 1].old_count)
+                              : 0;
+      size_t trail = last + 1 < blocks.size()
+                         ? std::min(context, blocks[last + 1].old_count)
+                         : 0;
+
+      const Block &begin = blocks[first];
+      const Block &end = blocks[last];
+      RenderHunkHeader(begin.old_start - lead,
+                       end.old_start + end.old_count + trail -
+                           (begin.old_start - lead),
+                       begin.new_start - lead,
+                       end.new_start + end.new_count + trail -
+                           (begin.new_start - lead));
+      RenderContext(begin.old_start - lead, begin.new_start - lead, lead);
+      for (size_t b = first; b <= last; ++b) {
+        if (blocks[b].equal) {
+          RenderContext(blocks[b].old_start, blocks[b].new_start,
+                        blocks[b].old_count);
+        } else {
+          RenderChange(blocks[b]);
+        }
+      }
+      RenderContext(end.old_start + end.old_count,
+                    end.new_start + end.new_count, trail);
+      first = last;
+    }
+  }
+
+private:
+  // Marker after the last line of a side that has no final line break,
+  // written right after that line is rendered
+  void RenderMissingNewline(bool old_side, size_t index) {
+    bool missing = old_side
+                       ? old_unterminated_ && index + 1 == old_lines_.size()
+                       : new_unterminated_ && index + 1 == new_lines_.size();
+    if (!missing) {
+      return;
+    }
+    FormatTo(out_, "\\ No newline at end of ", hunk_);
+    FormatTo(out_, old_side ? options_.expected_label : options_.actual_label,
+             hunk_);
+    out_.push_back('\n');
+  }
+
+  bool side_by_side() const {
+    return options_.layout == DiffLayout::SideBySide;
+  }
+
+  void RenderTitle() {
+    if (side_by_side()) {
+      size_t used = AppendLine(LineView{options_.expected_label}, title_,
+                               title_, column_width_);
+      out_.append(column_width_ - used + 3, ' ');
+      AppendLine(LineView{options_.actual_label}, title_, title_,
+                 column_width_);
+    } else {
+      FormatTo(out_, "--- ", title_);
+      FormatTo(out_, options_.expected_label, title_);
+      out_.push_back('\n');
+      FormatTo(out_, "+++ ", title_);
+      FormatTo(out_, options_.actual_label, title_);
+    }
+    out_.push_back('\n');
+  }
+
+  void RenderHunkHeader(size_t old_start, size_t old_count, size_t new_start,
+                        size_t new_count) {
+    std::string header = "@@ -";
+    AppendRange(header, old_start, old_count);
+    header.append(" +");
+    AppendRange(header, new_start, new_count);
+    header.append(" @@");
+    FormatTo(out_, header, hunk_);
+    out_.push_back('\n');
+  }
+
+  // Unified range: 1-based start, count omitted when it is 1
+  static void AppendRange(std::string &out, size_t start, size_t count) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits),
+                                count == 0 ? start : start + 1);
+    out.append(digits, result.ptr);
+    if (count != 1) {
+      out.push_back(',');
+      result = std::to_chars(digits, digits + sizeof(digits), count);
+      out.append(digits, result.ptr);
+    }
+  }
+
+  void RenderContext(size_t old_index, size_t new_index, size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+      LineView old_line{old_lines_[old_index + k]};
+      if (side_by_side()) {
+        LineView new_line{new_lines_[new_index + k]};
+        RenderRow(&old_line, ' ', &new_line);
+      } else {
+        out_.push_back(' ');
+        AppendLine(old_line, plain_, plain_);
+        out_.push_back('\n');
+      }
+    }
+  }
+
+  void RenderChange(const Block &block) {
+    size_t pairs = std::min(block.old_count, block.new_count);
+    if (inline_.size() < pairs) {
+      inline_.resize(pairs);
+    }
+    for (size_t k = 0; k < pairs; ++k) {
+      ComputeInline(old_lines_[block.old_start + k],
+                    new_lines_[block.new_start + k], inline_[k]);
+    }
+
+    auto old_view = [&](size_t k) {
+      LineView view{old_lines_[block.old_start + k]};
+      if (k < pairs && inline_[k].valid) {
+        view.characters = &inline_[k].old_characters;
+        view.changed = &inline_[k].old_changed;
+      }
+      return view;
+    };
+    auto new_view = [&](size_t k) {
+      LineView view{new_lines_[block.new_start + k]};
+      if (k < pairs && inline_[k].valid) {
+        view.characters = &inline_[k].new_characters;
+        view.changed = &inline_[k].new_changed;
+      }
+      return view;
+    };
+
+    if (side_by_side()) {
+      size_t rows = std::max(block.old_count, block.new_count);
+      for (size_t k = 0; k < rows; ++k) {
+        LineView left = k < block.old_count ? old_view(k) : LineView{};
+        LineView right = k < block.new_count ? new_view(k) : LineView{};
+        char marker = k >= block.new_count   ? '<'
+                      : k >= block.old_count ? '>'
+                                             : '|';
+        RenderRow(k < block.old_count ? &left : nullptr, marker,
+                  k < block.new_count ? &right : nullptr);
+        if (k < block.old_count) {
+          RenderMissingNewline(true, block.old_start + k);
+        }
+        if (k < block.new_count) {
+          RenderMissingNewline(false, block.new_start + k);
+        }
+      }
+      return;
+    }
+
+    for (size_t k = 0; k < block.old_count; ++k) {
+      FormatTo(out_, "-", deleted_);
+      AppendLine(old_view(k), deleted_, deleted_changed_);
+      out_.push_back('\n');
+      RenderMissingNewline(true, block.old_start + k);
+    }
+    for (size_t k = 0; k < block.new_count; ++k) {
+      FormatTo(out_, "+", inserted_);
+      AppendLine(new_view(k), inserted_, inserted_changed_);
+      out_.push_back('\n');
+      RenderMissingNewline(false, block.new_start + k);
+    }
+  }
+
+  void RenderRow(const LineView *left, char marker, const LineView *right) {
+    bool changed = marker != ' ';
+    size_t used = 0;
+    if (left != nullptr) {
+      used = AppendLine(*left, changed ? deleted_ : plain_,
+                        deleted_changed_, column_width_);
+    }
+    out_.append(column_width_ - used + 1, ' ');
+    out_.push_back(marker);
+    if (right != nullptr) {
+      out_.push_back(' ');
+      AppendLine(*right, changed ? inserted_ : plain_, inserted_changed_,
+                 column_width_);
+    }
+    out_.push_back('\n');
+  }
+
+  void ComputeInline(std::string_view old_line, std::string_view new_line,
+                     InlineDiff &diff) {
+    diff.valid = false;
+    if (!options_.inline_changes || !options_.color ||
+        old_line.size() > kMaxInlineBytes ||
+        new_line.size() > kMaxInlineBytes) {
+      return;
+    }
+
+    // Highlighting lines that share little is noise, not help. Bytes the
+    // lines have in common bound the unchanged part from above.
+    size_t limit = std::max(old_line.size(), new_line.size());
+    size_t counts[256] = {};
+    for (char c : old_line) {
+      ++counts[static_cast<unsigned char>(c)];
+    }
+    size_t common = 0;
+    for (char c : new_line) {
+      size_t &count = counts[static_cast<unsigned char>(c)];
+      if (count != 0) {
+        --count;
+        ++common;
+      }
+    }
+    if (common * 2 < limit) {
+      return;
+    }
+
+    SplitCharacters(old_line, diff.old_characters);
+    SplitCharacters(new_line, diff.new_characters);
+    const auto &a = diff.old_characters;
+    const auto &b = diff.new_characters;
+    MyersDiff myers(a.size(), b.size(), [&](ptrdiff_t x, ptrdiff_t y) {
+      return a[static_cast<size_t>(x)] == b[static_cast<size_t>(y)];
+    });
+
+    size_t unchanged = 0;
+    for (size_t k = 0; k < a.size(); ++k) {
+      unchanged += myers.deleted[k] ? 0 : a[k].size();
+    }
+    if (unchanged * 2 < limit) {
+      return;
+    }
+    diff.old_changed = std::move(myers.deleted);
+    diff.new_changed = std::move(myers.inserted);
+    diff.valid = true;
+  }
+
+  // Append a line, highlighting changed characters and clipping it to
+  // max_columns. Returns the number of columns written.
+  size_t AppendLine(const LineView &line, const FormatOptions &base,
+                    const FormatOptions &highlight,
+                    size_t max_columns = std::string_view::npos) {
+    if (line.characters == nullptr) {
+      if (max_columns == std::string_view::npos) {
+        FormatTo(out_, line.text, base);
+        return 0;
+      }
+      const char *pos = line.text.data();
+      const char *end = pos + line.text.size();
+      size_t columns = 0;
+      while (pos < end) {
+        const char *next = pos;
+        size_t width = detail::CodepointWidth(detail::DecodeUtf8(next, end));
+        if (columns + width > max_columns) {
+          break;
+        }
+        columns += width;
+        pos = next;
+      }
+      FormatTo(out_,
+               line.text.substr(0, static_cast<size_t>(pos - line.text.data())),
+               base);
+      return columns;
+    }
+
+    const auto &characters = *line.characters;
+    const auto &changed = *line.changed;
+    size_t columns = 0;
+    size_t k = 0;
+    while (k < characters.size()) {
+      size_t run = k;
+      bool clipped = false;
+      while (k < characters.size() && changed[k] == changed[run]) {
+        const char *pos = characters[k].data();
+        size_t width = detail::CodepointWidth(
+            detail::DecodeUtf8(pos, pos + characters[k].size()));
+        if (max_columns != std::string_view::npos &&
+            columns + width > max_columns) {
+          clipped = true;
+          break;
+        }
+        columns += width;
+        ++k;
+      }
+      if (k > run) {
+        std::string_view text(
+            characters[run].data(),
+            static_cast<size_t>(characters[k - 1].data() +
+                                characters[k - 1].size() -
+                                characters[run].data()));
+        FormatTo(out_, text, changed[run] ? highlight : base);
+      }
+      if (clipped) {
+        break;
+      }
+    }
+    return columns;
+  }
+
+  const std::vector<std::string_view> &old_lines_;
+  const std::vector<std::string_view> &new_lines_;
+  bool old_unterminated_; // Last old line has no line break
+  bool new_unterminated_; // Last new line has no line break
+  const DiffOptions &options_;
+  std::string &out_;
+  FormatOptions plain_;
+  FormatOptions title_;
+  FormatOptions hunk_;
+  FormatOptions deleted_;
+  FormatOptions inserted_;
+  FormatOptions deleted_changed_;
+  FormatOptions inserted_changed_;
+  size_t column_width_;
+  std::vector<InlineDiff> inline_; // Reused across change blocks
+};
+
+} // anonymous namespace
+
+std::string Diff(std::string_view expected, std::string_view actual,
+                 const DiffOptions &options) {
+  CONMAT_STATS_SCOPE(stats::Api::Diff, expected.size() + actual.size());
+  std::string result;
+  if (expected == actual) {
+    return result;
+  }
+
+  std::vector<std::string_view> old_lines = SplitLines(expected);
+  std::vector<std::string_view> new_lines = SplitLines(actual);
+
+  // A last line without a line break differs from the same text with
+  // one, as in GNU diff, so it is interned separately
+  bool old_unterminated = !expected.empty() && !expected.ends_with('\n');
+  bool new_unterminated = !actual.empty() && !actual.ends_with('\n');
+
+  // Compare lines by id so the search never compares strings
+  std::unordered_map<std::string_view, uint32_t> ids;
+  std::unordered_map<std::string_view, uint32_t> unterminated_ids;
+  ids.reserve(old_lines.size() + new_lines.size());
+  uint32_t id_count = 0;
+  auto intern = [&](const std::vector<std::string_view> &lines,
+                    bool unterminated) {
+    std::vector<uint32_t> line_ids;
+    line_ids.reserve(lines.size());
+    for (size_t k = 0; k < lines.size(); ++k) {
+      auto &table =
+          unterminated && k + 1 == lines.size() ? unterminated_ids : ids;
+      auto [it, added] = table.try_emplace(lines[k], id_count);
+      id_count += added;
+      line_ids.push_back(it->second);
+    }
+    return line_ids;
+  };
+  std::vector<uint32_t> old_ids = intern(old_lines, old_unterminated);
+  std::vector<uint32_t> new_ids = intern(new_lines, new_unterminated);
+
+  // Lines that occur in only one text can never match; leaving them out
+  // of the search keeps it fast when most lines were rewritten
+  std::vector<uint8_t> on_old_side(id_count, 0);
+  std::vector<uint8_t> on_new_side(id_count, 0);
+  for (uint32_t id : old_ids) {
+    on_old_side[id] = 1;
+  }
+  for (uint32_t id : new_ids) {
+    on_new_side[id] = 1;
+  }
+  std::vector<uint8_t> deleted(old_ids.size(), 1);
+  std::vector<uint8_t> inserted(new_ids.size(), 1);
+  std::vector<size_t> old_kept;
+  std::vector<size_t> new_kept;
+  for (size_t k = 0; k < old_ids.size(); ++k) {
+    if (on_new_side[old_ids[k]]) {
+      old_kept.push_back(k);
+    }
+  }
+  for (size_t k = 0; k < new_ids.size(); ++k) {
+    if (on_old_side[new_ids[k]]) {
+      new_kept.push_back(k);
+    }
+  }
+
+  MyersDiff myers(old_kept.size(), new_kept.size(),
+                  [&](ptrdiff_t x, ptrdiff_t y) {
+                    return old_ids[old_kept[static_cast<size_t>(x)]] ==
+                           new_ids[new_kept[static_cast<size_t>(y)]];
+                  });
+  for (size_t k = 0; k < old_kept.size(); ++k) {
+    deleted[old_kept[k]] = myers.deleted[k];
+  }
+  for (size_t k = 0; k < new_kept.size(); ++k) {
+    inserted[new_kept[k]] = myers.inserted[k];
+  }
+
+  std::vector<Block> blocks;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < old_ids.size() || j < new_ids.size()) {
+    Block block{false, i, j, 0, 0};
+    if (i < old_ids.size() && j < new_ids.size() && !deleted[i] &&
+        !inserted[j]) {
+      block.equal = true;
+      while (i < old_ids.size() && j < new_ids.size() && !deleted[i] &&
+             !inserted[j]) {
+        ++i;
+        ++j;
+      }
+    } else {
+      while (i < old_ids.size() && deleted[i]) {
+        ++i;
+      }
+      while (j < new_ids.size() && inserted[j]) {
+        ++j;
+      }
+    }
+    block.old_count = i - block.old_start;
+    block.new_count = j - block.new_start;
+    blocks.push_back(block);
+  }
+
+  DiffRenderer renderer(old_lines, new_lines, old_unterminated,
+                        new_unterminated, options, result);
+  renderer.Render(blocks);
+  CONMAT_STATS_OUTPUT(result.size(), 0);
+  return result;
+}
+
+} // namespace conmat
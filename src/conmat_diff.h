@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Presentation of a rendered diff
+///
+////////////////////////////////////////////////////////////
+enum class DiffLayout {
+  Unified,   // "-" and "+" lines under "@@" hunk headers
+  SideBySide // expected on the left, actual on the right
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Options for Diff()
+///
+////////////////////////////////////////////////////////////
+struct DiffOptions {
+  DiffLayout layout = DiffLayout::Unified;
+  size_t context = 3;          // Unchanged lines shown around each change
+  size_t width = 160;          // Total line width of side-by-side output
+  bool color = true;           // False renders plain text without escapes
+  bool inline_changes = true;  // Highlight changed characters within lines
+  std::string_view expected_label = "expected";
+  std::string_view actual_label = "actual";
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Render the differences between two texts
+///
+/// Lines are compared with Myers' O(ND) algorithm in its linear-space
+/// form; when the edit distance gets very large the search is cut short
+/// with the same cost heuristic as GNU diff, so the result may then be
+/// slightly longer than minimal but the run time stays near-linear.
+/// Changed lines that pair up are diffed again by character to
+/// highlight the exact edits. Unchanged regions longer than twice the
+/// context are collapsed into separate hunks.
+///
+/// Control characters (including ESC) are removed from the displayed
+/// lines as by Sanitize(), so colored text shows its escape parameters.
+///
+/// \param expected Original text
+/// \param actual Changed text
+/// \param options Layout, context and coloring
+/// \return The rendered diff, empty if the texts are equal
+///
+/// \example
+/// if (actual != expected) {
+///   std::cout << TestFailed() << " render\n" << Diff(expected, actual);
+/// }
+///
+////////////////////////////////////////////////////////////
+std::string Diff(std::string_view expected, std::string_view actual,
+                 const DiffOptions &options = {});
+
+} // namespace conmat
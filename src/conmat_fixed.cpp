@@ -0,0 +1,265 @@
+#include "conmat_fixed.h"
+#include "conmat_codes.h"
+#include "conmat_config.h"
+#include "conmat_simd.h"
+#include "conmat_sink.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace conmat {
+
+namespace {
+
+bool HasFormatting(const FormatOptions &options) {
+  return options.foreground != Color::Default ||
+         options.background != Color::Default ||
+         options.style != Style::Default;
+}
+
+char PaddingCharacter(size_t level) {
+  switch (level) {
+  case 1:
+    return '=';
+  case 2:
+    return '-';
+  case 3:
+    return '~';
+  default:
+    return '.';
+  }
+}
+
+// Length of text after removing the bytes Sanitize removes
+size_t SanitizedLength(std::string_view text) {
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  size_t length = 0;
+  while (pos != end) {
+    const char *unsafe = detail::FindUnsafeByte(pos, end);
+    length += static_cast<size_t>(unsafe - pos);
+    pos = unsafe == end ? end : unsafe + 1;
+  }
+  return length;
+}
+
+} // anonymous namespace
+
+FixedFormatterBase::FixedFormatterBase(char *data, size_t capacity) noexcept
+    : data_(data), capacity_(capacity),
+      limit_(capacity > detail::RESET.size() ? capacity - detail::RESET.size()
+                                             : 0) {}
+
+FixedFormatterBase &FixedFormatterBase::Append(std::string_view text) noexcept {
+  if (truncated_) {
+    return *this;
+  }
+  size_t room = limit_ > size_ ? limit_ - size_ : 0;
+  size_t length = text.size();
+  if (length > room) {
+    // Cut before the continuation bytes of a split UTF-8 character
+    length = room;
+    while (length > 0 &&
+           (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80) {
+      --length;
+    }
+  }
+  std::memcpy(data_ + size_, text.data(), length);
+  size_ += length;
+  if (length != text.size()) {
+    Overflow();
+  }
+  return *this;
+}
+
+FixedFormatterBase &FixedFormatterBase::Append(size_t count, char c) noexcept {
+  if (truncated_) {
+    return *this;
+  }
+  size_t room = limit_ > size_ ? limit_ - size_ : 0;
+  size_t length = count < room ? count : room;
+  std::memset(data_ + size_, c, length);
+  size_ += length;
+  if (length != count) {
+    Overflow();
+  }
+  return *this;
+}
+
+FixedFormatterBase &FixedFormatterBase::AppendNumber(long long value) noexcept {
+  char buffer[detail::kNumberBufferSize];
+  return Append(detail::NumberToText(buffer, value));
+}
+
+FixedFormatterBase &
+FixedFormatterBase::AppendNumber(unsigned long long value) noexcept {
+  char buffer[detail::kNumberBufferSize];
+  return Append(detail::NumberToText(buffer, value));
+}
+
+FixedFormatterBase &FixedFormatterBase::AppendNumber(double value) noexcept {
+  char buffer[detail::kNumberBufferSize];
+  return Append(detail::NumberToText(buffer, value));
+}
+
+FixedFormatterBase &
+FixedFormatterBase::Format(std::string_view text,
+                           const FormatOptions &options) noexcept {
+  if (AppendCode(detail::get_style_code(options.style)) &&
+      AppendCode(detail::get_fg_color_code(options.foreground)) &&
+      AppendCode(detail::get_bg_color_code(options.background))) {
+    AppendSanitized(text);
+  }
+  if (options.reset_after) {
+    AppendReset();
+  }
+  return *this;
+}
+
+FixedFormatterBase &
+FixedFormatterBase::Divider(std::string_view symbol, size_t width,
+                            const FormatOptions &options) noexcept {
+  // Sanitize the symbol into a small buffer; longer symbols are cut
+  char safe[64];
+  size_t length = 0;
+  const char *pos = symbol.data();
+  const char *end = pos + symbol.size();
+  while (pos != end && length < sizeof(safe)) {
+    const char *unsafe = detail::FindUnsafeByte(pos, end);
+    size_t run = static_cast<size_t>(unsafe - pos);
+    run = run < sizeof(safe) - length ? run : sizeof(safe) - length;
+    std::memcpy(safe + length, pos, run);
+    length += run;
+    pos = unsafe == end ? end : unsafe + 1;
+  }
+  if (length == 0 || width == 0) {
+    return *this;
+  }
+
+  bool formatted = HasFormatting(options);
+  if (formatted) {
+    FormatOptions codes = options;
+    codes.reset_after = false;
+    Format("", codes);
+  }
+  for (size_t i = 0; i < width / length; ++i) {
+    Append(std::string_view(safe, length));
+  }
+  Append(std::string_view(safe, width % length));
+  if (formatted && options.reset_after) {
+    AppendReset();
+  }
+  return *this;
+}
+
+FixedFormatterBase &
+FixedFormatterBase::Divider(size_t width,
+                            const FormatOptions &options) noexcept {
+  return Divider(CONMAT_DEFAULT_DIVIDER_SYMBOL, width, options);
+}
+
+FixedFormatterBase &
+FixedFormatterBase::Header(std::string_view text, size_t level, size_t width,
+                           const FormatOptions &options) noexcept {
+  constexpr size_t kMinPadding = 3;
+  char padding = PaddingCharacter(level);
+  size_t text_length = SanitizedLength(text);
+
+  size_t left = kMinPadding;
+  size_t right = kMinPadding;
+  if (text_length + 2 + 2 * kMinPadding <= width) {
+    size_t total = width - text_length - 2;
+    left = total / 2;
+    right = total - left;
+  }
+
+  bool formatted = HasFormatting(options);
+  if (formatted) {
+    FormatOptions codes = options;
+    codes.reset_after = false;
+    Format("", codes);
+  }
+  Append(left, padding).Append(' ');
+  AppendSanitized(text);
+  Append(' ').Append(right, padding);
+  if (formatted && options.reset_after) {
+    AppendReset();
+  }
+  return *this;
+}
+
+FixedFormatterBase &
+FixedFormatterBase::Indent(size_t level, size_t spaces_per_level) noexcept {
+  return Append(level * spaces_per_level, ' ');
+}
+
+FixedFormatterBase &FixedFormatterBase::TestInProgress() noexcept {
+  return Format("[...]", Color::Yellow);
+}
+
+FixedFormatterBase &FixedFormatterBase::TestPassed() noexcept {
+  return Format("[✓]", Color::Green);
+}
+
+FixedFormatterBase &FixedFormatterBase::TestFailed() noexcept {
+  return Format("[✗]", Color::Red);
+}
+
+bool FixedFormatterBase::Flush(int fd) noexcept {
+  bool ok = WriteAll(fd, view());
+  clear();
+  return ok;
+}
+
+bool FixedFormatterBase::AppendCode(std::string_view code) noexcept {
+  if (code.empty()) {
+    return !truncated_;
+  }
+  if (truncated_ || code.size() > limit_ - std::min(size_, limit_)) {
+    // Escape sequences are written whole or not at all
+    Overflow();
+    return false;
+  }
+  std::memcpy(data_ + size_, code.data(), code.size());
+  size_ += code.size();
+  style_open_ = true;
+  return true;
+}
+
+void FixedFormatterBase::AppendSanitized(std::string_view text) noexcept {
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos != end && !truncated_) {
+    const char *unsafe = detail::FindUnsafeByte(pos, end);
+    Append(std::string_view(pos, static_cast<size_t>(unsafe - pos)));
+    pos = unsafe == end ? end : unsafe + 1;
+  }
+}
+
+void FixedFormatterBase::AppendReset() noexcept {
+  if (truncated_) {
+    return;
+  }
+  if (capacity_ - size_ < detail::RESET.size()) {
+    Overflow();
+    return;
+  }
+  std::memcpy(data_ + size_, detail::RESET.data(), detail::RESET.size());
+  size_ += detail::RESET.size();
+  style_open_ = false;
+}
+
+void FixedFormatterBase::Overflow() noexcept {
+  if (truncated_) {
+    return;
+  }
+  truncated_ = true;
+  if (style_open_) {
+    // An open style implies size_ <= limit_, so the reserve is free
+    std::memcpy(data_ + size_, detail::RESET.data(), detail::RESET.size());
+    size_ += detail::RESET.size();
+    style_open_ = false;
+  }
+}
+
+} // namespace conmat
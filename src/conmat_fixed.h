@@ -0,0 +1,199 @@
+#pragma once
+
+#include "conmat.h"
+#include <cstddef>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Formatter writing into a fixed buffer, usable in signal handlers
+///
+/// Provides Format, Divider, Header, Indent and the test status marks
+/// with the same output as the allocating functions, but writes into a
+/// caller-provided array. Nothing allocates, takes a lock, throws or
+/// touches iostreams, so a formatter may be used in signal handlers
+/// and on real-time threads. Numbers are converted with std::to_chars
+/// and Flush() hands the buffer to write(2).
+///
+/// Overflow truncates deterministically: the result is the longest
+/// prefix that fits, cut at a UTF-8 character boundary and never inside
+/// an escape sequence. Everything appended after the first overflow is
+/// dropped. The last bytes of the buffer are held back for a reset, so
+/// an open style is closed when the output is truncated.
+///
+/// Use FixedFormatter<N> to get the buffer on the stack; functions can
+/// take a FixedFormatterBase reference to accept any size.
+///
+////////////////////////////////////////////////////////////
+class FixedFormatterBase {
+public:
+  FixedFormatterBase(const FixedFormatterBase &) = delete;
+  FixedFormatterBase &operator=(const FixedFormatterBase &) = delete;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append raw bytes
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Append(std::string_view text) noexcept;
+
+  FixedFormatterBase &Append(char c) noexcept {
+    return Append(std::string_view(&c, 1));
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append count copies of a character
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Append(size_t count, char c) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a number, formatted as by Format()
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &AppendNumber(long long value) noexcept;
+  FixedFormatterBase &AppendNumber(unsigned long long value) noexcept;
+  FixedFormatterBase &AppendNumber(double value) noexcept;
+
+  template <typename T>
+    requires detail::NumberLike<T> && (!detail::CharLike<T>) &&
+             (!detail::SameAs<T, bool>)
+  FixedFormatterBase &AppendNumber(T value) noexcept {
+    using Number = std::conditional_t<
+        std::is_floating_point_v<T>, double,
+        std::conditional_t<std::is_signed_v<T>, long long,
+                           unsigned long long>>;
+    return AppendNumber(static_cast<Number>(value));
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append sanitized text with ANSI codes, as FormatTo()
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Format(std::string_view text,
+                             const FormatOptions &options = {}) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a number with ANSI codes, as Format()
+  ///
+  ////////////////////////////////////////////////////////////
+  template <typename T>
+    requires detail::NumberLike<T> && (!detail::CharLike<T>) &&
+             (!detail::SameAs<T, bool>)
+  FixedFormatterBase &Format(T value,
+                             const FormatOptions &options = {}) noexcept {
+    using Number = std::conditional_t<
+        std::is_floating_point_v<T>, double,
+        std::conditional_t<std::is_signed_v<T>, long long,
+                           unsigned long long>>;
+    char buffer[detail::kNumberBufferSize];
+    return Format(detail::NumberToText(buffer, static_cast<Number>(value)),
+                  options);
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a divider line, as Divider()
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Divider(std::string_view symbol, size_t width = 80,
+                              const FormatOptions &options = {}) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a divider of the configured default symbol
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Divider(size_t width = 80,
+                              const FormatOptions &options = {}) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a centered header, as Header()
+  ///
+  /// The text is sanitized before it is measured.
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Header(std::string_view text, size_t level,
+                             size_t width = 80,
+                             const FormatOptions &options = {}) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append indentation, as Indent()
+  ///
+  ////////////////////////////////////////////////////////////
+  FixedFormatterBase &Indent(size_t level,
+                             size_t spaces_per_level = 2) noexcept;
+
+  FixedFormatterBase &TestInProgress() noexcept;
+  FixedFormatterBase &TestPassed() noexcept;
+  FixedFormatterBase &TestFailed() noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Write the buffer to a file descriptor and clear it
+  ///
+  /// Retries on partial writes and EINTR; safe in signal handlers.
+  ///
+  /// \param fd File descriptor to write to
+  /// \return True if every byte was written
+  ///
+  ////////////////////////////////////////////////////////////
+  bool Flush(int fd = 2) noexcept;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Discard the contents and the overflow state
+  ///
+  ////////////////////////////////////////////////////////////
+  void clear() noexcept {
+    size_ = 0;
+    truncated_ = false;
+    style_open_ = false;
+  }
+
+  std::string_view view() const noexcept { return {data_, size_}; }
+  size_t size() const noexcept { return size_; }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether output was dropped since the last clear
+  ///
+  ////////////////////////////////////////////////////////////
+  bool truncated() const noexcept { return truncated_; }
+
+protected:
+  FixedFormatterBase(char *data, size_t capacity) noexcept;
+  ~FixedFormatterBase() = default;
+
+private:
+  bool AppendCode(std::string_view code) noexcept;
+  void AppendSanitized(std::string_view text) noexcept;
+  void AppendReset() noexcept;
+  void Overflow() noexcept;
+
+  char *data_;
+  size_t capacity_; // Whole buffer
+  size_t limit_;    // Buffer without the bytes held back for a reset
+  size_t size_ = 0;
+  bool truncated_ = false;
+  bool style_open_ = false; // Codes written without a reset yet
+};
+
+////////////////////////////////////////////////////////////
+/// \brief FixedFormatterBase with an N-byte buffer of its own
+///
+/// \example
+/// void OnCrash(int signal) {
+///   FixedFormatter<512> out;
+///   out.TestFailed().Append(' ').Header("crash", 1, 60, {Color::Red});
+///   out.Append("\nsignal ").AppendNumber(signal).Append('\n');
+///   out.Flush(2);
+/// }
+///
+////////////////////////////////////////////////////////////
+template <size_t N> class FixedFormatter : public FixedFormatterBase {
+  static_assert(N >= 16, "FixedFormatter needs room for a reset sequence");
+
+public:
+  FixedFormatter() noexcept : FixedFormatterBase(storage_, N) {}
+
+private:
+  char storage_[N];
+};
+
+} // namespace conmat
@@ -0,0 +1,226 @@
+#include "conmat_gradient.h"
+#include "conmat_stats_scope.h"
+#include "conmat_text.h"
+#include <cmath>
+
+namespace conmat {
+
+namespace {
+
+// Levels of the 256-color cube
+constexpr uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+// Longest color sequence, "ESC [ 38;2;255;255;255 m"
+constexpr size_t kMaxColorSequence = 19;
+
+int CubeLevel(uint8_t value) {
+  if (value < 48) {
+    return 0;
+  }
+  if (value < 115) {
+    return 1;
+  }
+  return (value - 35) / 40;
+}
+
+int Distance(int r, int g, int b, const SgrColor &color) {
+  int dr = r - color.red;
+  int dg = g - color.green;
+  int db = b - color.blue;
+  return dr * dr + dg * dg + db * db;
+}
+
+// Nearest of the 6x6x6 cube and the grayscale ramp
+uint8_t PaletteIndex(const SgrColor &color) {
+  int r = CubeLevel(color.red);
+  int g = CubeLevel(color.green);
+  int b = CubeLevel(color.blue);
+  int cube_distance =
+      Distance(kCubeLevels[r], kCubeLevels[g], kCubeLevels[b], color);
+
+  int average = (color.red + color.green + color.blue) / 3;
+  int gray = average < 8 ? 0 : average > 238 ? 23 : (average - 3) / 10;
+  int level = 8 + 10 * gray;
+  int gray_distance = Distance(level, level, level, color);
+
+  if (gray_distance < cube_distance) {
+    return static_cast<uint8_t>(232 + gray);
+  }
+  return static_cast<uint8_t>(16 + 36 * r + 6 * g + b);
+}
+
+uint8_t Mix(uint8_t from, uint8_t to, double t) {
+  return static_cast<uint8_t>(std::lround(from + (to - from) * t));
+}
+
+// Number of characters ColorCharactersTo assigns an index to
+size_t CountCharacters(std::string_view text) {
+  size_t count = 0;
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos < end) {
+    unsigned char byte = static_cast<unsigned char>(*pos);
+    if (byte < 0x80) {
+      ++pos;
+      count += byte >= 0x20 && byte != 0x7F;
+    } else {
+      count += detail::CodepointWidth(detail::DecodeUtf8(pos, end)) != 0;
+    }
+  }
+  return count;
+}
+
+void AppendForeground(std::string &out, const SgrColor &color) {
+  if (color.kind == SgrColor::Kind::Default) {
+    out.append("\033[39m");
+    return;
+  }
+  SgrState state;
+  state.foreground = color;
+  state.AppendTo(out);
+}
+
+} // anonymous namespace
+
+SgrColor QuantizeColor(const SgrColor &color, ColorDepth depth) {
+  switch (depth) {
+  case ColorDepth::Basic: {
+    int index = color.BasicIndex();
+    if (index < 0) {
+      return {};
+    }
+    return {SgrColor::Kind::Indexed, static_cast<uint8_t>(index)};
+  }
+  case ColorDepth::Palette:
+    if (color.kind == SgrColor::Kind::Rgb) {
+      return {SgrColor::Kind::Indexed, PaletteIndex(color)};
+    }
+    return color;
+  case ColorDepth::TrueColor:
+    break;
+  }
+  return color;
+}
+
+SgrColor GradientColor(std::span<const SgrColor> stops, double position) {
+  if (stops.empty()) {
+    return {};
+  }
+  if (!(position > 0.0)) {
+    return stops.front();
+  }
+  if (position >= 1.0 || stops.size() == 1) {
+    return stops.back();
+  }
+
+  double scaled = position * static_cast<double>(stops.size() - 1);
+  size_t index = static_cast<size_t>(scaled);
+  double t = scaled - static_cast<double>(index);
+  const SgrColor &from = stops[index];
+  const SgrColor &to = stops[index + 1];
+  if (from.kind != SgrColor::Kind::Rgb || to.kind != SgrColor::Kind::Rgb) {
+    // Palette colors are not interpolated
+    return t < 0.5 ? from : to;
+  }
+  return Rgb(Mix(from.red, to.red, t), Mix(from.green, to.green, t),
+             Mix(from.blue, to.blue, t));
+}
+
+namespace detail {
+
+void ColorCharactersTo(std::string &out, std::string_view text,
+                       ColorDepth depth, CharacterColorFunction function,
+                       void *context) {
+  CONMAT_STATS_SCOPE(stats::Api::Gradient, text.size());
+  [[maybe_unused]] size_t start = out.size();
+  [[maybe_unused]] size_t escape_bytes = 0;
+  SgrColor current;
+  size_t index = 0;
+
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos < end) {
+    const char *character = pos;
+    unsigned char byte = static_cast<unsigned char>(*pos);
+    if (byte < 0x80) {
+      ++pos;
+      if (byte < 0x20 || byte == 0x7F) {
+        // Line breaks and tabs are kept as by Sanitize() without taking
+        // a color index, so multi-line text stays multi-line
+        if (byte == '\n' || byte == '\t' || byte == '\r') {
+          out.push_back(static_cast<char>(byte));
+        }
+        continue;
+      }
+    } else if (CodepointWidth(DecodeUtf8(pos, end)) == 0) {
+      // Combining marks keep the color of their base character
+      out.append(character, pos);
+      continue;
+    }
+
+    SgrColor color = QuantizeColor(function(context, index++), depth);
+    if (color != current) {
+      size_t before = out.size();
+      AppendForeground(out, color);
+      escape_bytes += out.size() - before;
+      current = color;
+    }
+    out.append(character, pos);
+  }
+
+  if (current.kind != SgrColor::Kind::Default) {
+    out.append("\033[0m");
+    escape_bytes += 4;
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, escape_bytes);
+}
+
+} // namespace detail
+
+void GradientTo(std::string &out, std::string_view text,
+                std::span<const SgrColor> stops, ColorDepth depth) {
+  size_t count = CountCharacters(text);
+  double last = count > 1 ? static_cast<double>(count - 1) : 1.0;
+  ColorCharactersTo(
+      out, text,
+      [&](size_t index) {
+        return GradientColor(stops, static_cast<double>(index) / last);
+      },
+      depth);
+}
+
+std::string Gradient(std::string_view text, std::span<const SgrColor> stops,
+                     ColorDepth depth) {
+  // Count the color changes first, so the result is reserved once and
+  // stays proportional to them
+  size_t count = CountCharacters(text);
+  double last = count > 1 ? static_cast<double>(count - 1) : 1.0;
+  size_t changes = 0;
+  SgrColor current;
+  for (size_t index = 0; index < count; ++index) {
+    SgrColor color = QuantizeColor(
+        GradientColor(stops, static_cast<double>(index) / last), depth);
+    changes += color != current;
+    current = color;
+  }
+  std::string result;
+  result.reserve(text.size() + changes * kMaxColorSequence + 4);
+  GradientTo(result, text, stops, depth);
+  return result;
+}
+
+void ColorByValueTo(std::string &out, std::string_view text,
+                    std::span<const double> values,
+                    std::span<const SgrColor> stops, ColorDepth depth) {
+  ColorCharactersTo(
+      out, text,
+      [&](size_t index) {
+        if (index >= values.size()) {
+          return SgrColor{};
+        }
+        return GradientColor(stops, values[index]);
+      },
+      depth);
+}
+
+} // namespace conmat
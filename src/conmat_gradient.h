@@ -0,0 +1,153 @@
+#pragma once
+
+#include "conmat_ansi.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Color capability of the target terminal
+///
+////////////////////////////////////////////////////////////
+enum class ColorDepth : uint8_t {
+  Basic,    // 16 colors (30-37, 90-97)
+  Palette,  // 256 colors (38;5;n)
+  TrueColor // 24-bit colors (38;2;r;g;b)
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Make a 24-bit color
+///
+////////////////////////////////////////////////////////////
+constexpr SgrColor Rgb(uint8_t red, uint8_t green, uint8_t blue) {
+  return {SgrColor::Kind::Rgb, 0, red, green, blue};
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Map a color to the nearest one available at a depth
+/// \param color Color to map
+/// \param depth Color capability of the terminal
+/// \return The color itself if the depth can show it
+///
+////////////////////////////////////////////////////////////
+SgrColor QuantizeColor(const SgrColor &color, ColorDepth depth);
+
+////////////////////////////////////////////////////////////
+/// \brief Interpolate linearly between evenly spaced color stops
+/// \param stops Gradient colors from position 0 to position 1
+/// \param position Position on the gradient, clamped to [0, 1]
+/// \return 24-bit color, or the default color if stops is empty
+///
+////////////////////////////////////////////////////////////
+SgrColor GradientColor(std::span<const SgrColor> stops, double position);
+
+namespace detail {
+
+/// \brief Color of the character at index, context is passed through
+using CharacterColorFunction = SgrColor (*)(void *context, size_t index);
+
+void ColorCharactersTo(std::string &out, std::string_view text,
+                       ColorDepth depth, CharacterColorFunction function,
+                       void *context);
+
+} // namespace detail
+
+////////////////////////////////////////////////////////////
+/// \brief Append text with a foreground color chosen per character
+///
+/// Characters are UTF-8 code points; combining marks and other
+/// zero-width characters take the color of the character before them
+/// and do not advance the index. Colors are quantized to the depth and
+/// adjacent characters with the same result form one run, so a color
+/// sequence is written only where the color changes and a single reset
+/// ends the text. The output size grows with the number of color
+/// changes, not with the number of characters.
+///
+/// Control characters are removed as by Sanitize(); line breaks and
+/// tabs are kept and take no index. The default color is allowed and
+/// leaves characters uncolored.
+///
+/// \param out String the colored text is appended to
+/// \param text The text to color
+/// \param color Callable returning the SgrColor of character index
+/// \param depth Color capability of the terminal
+///
+/// \example
+/// std::string out;
+/// ColorCharactersTo(out, "alternating", [](size_t i) {
+///   return SgrColor{SgrColor::Kind::Indexed, uint8_t(i / 3 % 2 ? 1 : 4)};
+/// });
+///
+////////////////////////////////////////////////////////////
+template <typename ColorFunction>
+  requires std::is_invocable_r_v<SgrColor, ColorFunction &, size_t>
+void ColorCharactersTo(std::string &out, std::string_view text,
+                       ColorFunction &&color,
+                       ColorDepth depth = ColorDepth::TrueColor) {
+  using Function = std::remove_reference_t<ColorFunction>;
+  detail::ColorCharactersTo(
+      out, text, depth,
+      [](void *context, size_t index) -> SgrColor {
+        return (*static_cast<Function *>(context))(index);
+      },
+      const_cast<void *>(static_cast<const void *>(std::addressof(color))));
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Append text colored with a gradient across its characters
+///
+/// The first character takes the first stop and the last character the
+/// last stop. Runs are merged as by ColorCharactersTo().
+///
+/// \param out String the colored text is appended to
+/// \param text The text to color
+/// \param stops Gradient colors, evenly spaced
+/// \param depth Color capability of the terminal
+///
+////////////////////////////////////////////////////////////
+void GradientTo(std::string &out, std::string_view text,
+                std::span<const SgrColor> stops,
+                ColorDepth depth = ColorDepth::TrueColor);
+
+////////////////////////////////////////////////////////////
+/// \brief Color text with a gradient across its characters
+/// \return The colored string
+///
+/// \example
+/// const SgrColor heat[] = {Rgb(0, 200, 0), Rgb(230, 200, 0),
+///                          Rgb(220, 0, 0)};
+/// std::cout << Gradient("██████████", heat) << '\n';
+///
+////////////////////////////////////////////////////////////
+std::string Gradient(std::string_view text, std::span<const SgrColor> stops,
+                     ColorDepth depth = ColorDepth::TrueColor);
+
+////////////////////////////////////////////////////////////
+/// \brief Append text with each character colored by a value
+///
+/// Character i takes GradientColor(stops, values[i]); characters past
+/// the end of values are left uncolored.
+///
+/// \param out String the colored text is appended to
+/// \param text The text to color
+/// \param values Gradient position of each character, 0 to 1
+/// \param stops Gradient colors, evenly spaced
+/// \param depth Color capability of the terminal
+///
+/// \example
+/// // Per-core utilization, one block per core
+/// ColorByValueTo(out, "████", loads, heat, ColorDepth::Palette);
+///
+////////////////////////////////////////////////////////////
+void ColorByValueTo(std::string &out, std::string_view text,
+                    std::span<const double> values,
+                    std::span<const SgrColor> stops,
+                    ColorDepth depth = ColorDepth::TrueColor);
+
+} // namespace conmat
@@ -0,0 +1,217 @@
+#include "conmat_html.h"
+#include "conmat_stats_scope.h"
+
+namespace conmat {
+
+namespace {
+
+// Class name suffixes of the 16 basic colors, in palette order
+constexpr std::string_view kColorNames[16] = {
+    "black",        "red",          "green",          "yellow",
+    "blue",         "magenta",      "cyan",           "white",
+    "bright-black", "bright-red",   "bright-green",   "bright-yellow",
+    "bright-blue",  "bright-magenta", "bright-cyan",  "bright-white"};
+
+// Class names of the attribute bits, in sgr_attribute order. Reverse is
+// applied by swapping colors and has no class of its own.
+constexpr std::string_view kAttributeNames[8] = {
+    "ansi-bold",  "ansi-dim", "ansi-italic", "ansi-underline",
+    "ansi-blink", "",         "ansi-hidden", "ansi-strike"};
+
+// Layout of a presentation key: foreground + 1, background + 1 (5 bits
+// each, 0 = default) and the attribute bits
+constexpr unsigned kBackgroundShift = 5;
+constexpr unsigned kAttributeShift = 10;
+
+// Bytes that need escaping or removal in HTML text
+struct EscapeTable {
+  bool special[256] = {};
+
+  constexpr EscapeTable() {
+    for (int c = 0; c < 0x20; ++c) {
+      special[c] = c != '\n' && c != '\t';
+    }
+    special[static_cast<unsigned char>('&')] = true;
+    special[static_cast<unsigned char>('<')] = true;
+    special[static_cast<unsigned char>('>')] = true;
+    special[0x7F] = true;
+  }
+};
+
+constexpr EscapeTable kEscapeTable;
+
+uint32_t PresentationKey(const SgrState &state) {
+  int fg = state.foreground.BasicIndex();
+  int bg = state.background.BasicIndex();
+  if (state.attributes & sgr_attribute::Reverse) {
+    // Swap colors, assuming light-on-dark defaults
+    int swapped_fg = bg < 0 ? 0 : bg;
+    bg = fg < 0 ? 7 : fg;
+    fg = swapped_fg;
+  }
+  uint32_t attributes = state.attributes & ~uint32_t{sgr_attribute::Reverse};
+  return static_cast<uint32_t>(fg + 1) |
+         (static_cast<uint32_t>(bg + 1) << kBackgroundShift) |
+         (attributes << kAttributeShift);
+}
+
+void AppendOpenSpan(uint32_t key, std::string &out) {
+  out.append("<span class=\"");
+  bool first = true;
+  auto append_class = [&](std::string_view prefix, std::string_view name) {
+    if (!first) {
+      out.push_back(' ');
+    }
+    first = false;
+    out.append(prefix);
+    out.append(name);
+  };
+
+  uint32_t fg = key & 0x1F;
+  uint32_t bg = (key >> kBackgroundShift) & 0x1F;
+  uint32_t attributes = key >> kAttributeShift;
+  if (fg != 0) {
+    append_class("ansi-", kColorNames[fg - 1]);
+  }
+  if (bg != 0) {
+    append_class("ansi-bg-", kColorNames[bg - 1]);
+  }
+  for (unsigned bit = 0; bit < 8; ++bit) {
+    if (attributes & (1u << bit)) {
+      append_class("", kAttributeNames[bit]);
+    }
+  }
+  out.append("\">");
+}
+
+} // anonymous namespace
+
+// Parser handler forwarding text and SGR state changes to the converter
+struct HtmlHandler {
+  AnsiToHtml &converter;
+  std::string &out;
+
+  void OnText(std::string_view text) { converter.AppendText(text, out); }
+
+  void OnSequence(const AnsiSequence &sequence) {
+    if (sequence.type == AnsiSequenceType::Sgr) {
+      converter.state_.Apply(sequence.parameters);
+    }
+  }
+};
+
+void AnsiToHtml::Feed(std::string_view chunk, std::string &out) {
+  CONMAT_STATS_SCOPE(stats::Api::AnsiToHtml, chunk.size());
+  [[maybe_unused]] size_t start = out.size();
+  HtmlHandler handler{*this, out};
+  parser_.Feed(chunk, handler);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void AnsiToHtml::Finish(std::string &out) {
+  if (open_key_ != 0) {
+    out.append("</span>");
+  }
+  parser_.Reset();
+  state_ = SgrState{};
+  open_key_ = 0;
+}
+
+void AnsiToHtml::AppendText(std::string_view text, std::string &out) {
+  // Style changes take effect lazily, so sequences that are overridden
+  // before any text appears never produce empty spans
+  uint32_t key = PresentationKey(state_);
+  if (key != open_key_) {
+    if (open_key_ != 0) {
+      out.append("</span>");
+    }
+    if (key != 0) {
+      AppendOpenSpan(key, out);
+    }
+    open_key_ = key;
+  }
+
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos < end) {
+    const char *run = pos;
+    while (pos < end && !kEscapeTable.special[static_cast<unsigned char>(*pos)]) {
+      ++pos;
+    }
+    out.append(run, pos);
+    if (pos == end) {
+      break;
+    }
+    switch (*pos) {
+    case '&':
+      out.append("&amp;");
+      break;
+    case '<':
+      out.append("&lt;");
+      break;
+    case '>':
+      out.append("&gt;");
+      break;
+    default:
+      // Remaining control bytes are dropped
+      break;
+    }
+    ++pos;
+  }
+}
+
+std::string_view AnsiToHtml::Stylesheet() {
+  return R"(pre.ansi { background: #000000; color: #e5e5e5; }
+.ansi-black { color: #000000; }
+.ansi-red { color: #cd0000; }
+.ansi-green { color: #00cd00; }
+.ansi-yellow { color: #cdcd00; }
+.ansi-blue { color: #0000ee; }
+.ansi-magenta { color: #cd00cd; }
+.ansi-cyan { color: #00cdcd; }
+.ansi-white { color: #e5e5e5; }
+.ansi-bright-black { color: #7f7f7f; }
+.ansi-bright-red { color: #ff0000; }
+.ansi-bright-green { color: #00ff00; }
+.ansi-bright-yellow { color: #ffff00; }
+.ansi-bright-blue { color: #5c5cff; }
+.ansi-bright-magenta { color: #ff00ff; }
+.ansi-bright-cyan { color: #00ffff; }
+.ansi-bright-white { color: #ffffff; }
+.ansi-bg-black { background-color: #000000; }
+.ansi-bg-red { background-color: #cd0000; }
+.ansi-bg-green { background-color: #00cd00; }
+.ansi-bg-yellow { background-color: #cdcd00; }
+.ansi-bg-blue { background-color: #0000ee; }
+.ansi-bg-magenta { background-color: #cd00cd; }
+.ansi-bg-cyan { background-color: #00cdcd; }
+.ansi-bg-white { background-color: #e5e5e5; }
+.ansi-bg-bright-black { background-color: #7f7f7f; }
+.ansi-bg-bright-red { background-color: #ff0000; }
+.ansi-bg-bright-green { background-color: #00ff00; }
+.ansi-bg-bright-yellow { background-color: #ffff00; }
+.ansi-bg-bright-blue { background-color: #5c5cff; }
+.ansi-bg-bright-magenta { background-color: #ff00ff; }
+.ansi-bg-bright-cyan { background-color: #00ffff; }
+.ansi-bg-bright-white { background-color: #ffffff; }
+.ansi-bold { font-weight: bold; }
+.ansi-dim { opacity: 0.7; }
+.ansi-italic { font-style: italic; }
+.ansi-underline { text-decoration: underline; }
+.ansi-blink { text-decoration: blink; }
+.ansi-hidden { visibility: hidden; }
+.ansi-strike { text-decoration: line-through; }
+.ansi-underline.ansi-strike { text-decoration: underline line-through; }
+)";
+}
+
+std::string AnsiToHtmlString(std::string_view text) {
+  std::string result;
+  result.reserve(text.size() + text.size() / 4);
+  AnsiToHtml converter;
+  converter.Feed(text, result);
+  converter.Finish(result);
+  return result;
+}
+
+} // namespace conmat
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "conmat_ansi.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming converter from ANSI colored text to HTML
+///
+/// SGR sequences are mapped onto a small set of CSS classes (see
+/// Stylesheet()); every other escape sequence is dropped. Text is HTML
+/// escaped in the same pass and adjacent runs with identical styling
+/// share one <span>. Memory use is independent of the input size: each
+/// Feed() only appends the converted chunk to `out`.
+///
+/// 256-color and 24-bit colors are mapped to the nearest basic color.
+///
+/// \example
+/// AnsiToHtml converter;
+/// std::string html;
+/// converter.Feed(Colorize("ok", Color::Green), html);
+/// converter.Finish(html);  // <span class="ansi-green">ok</span>
+///
+////////////////////////////////////////////////////////////
+class AnsiToHtml {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Convert the next chunk of input
+  /// \param chunk ANSI colored text, sequences may span chunks
+  /// \param out String the HTML is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Feed(std::string_view chunk, std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Close any open span and reset the converter
+  /// \param out String the closing markup is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Finish(std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief CSS rules for every class the converter emits
+  ///
+  ////////////////////////////////////////////////////////////
+  static std::string_view Stylesheet();
+
+private:
+  friend struct HtmlHandler;
+
+  void AppendText(std::string_view text, std::string &out);
+
+  AnsiStreamParser parser_;
+  SgrState state_;
+  uint32_t open_key_ = 0; // Presentation of the open span, 0 if none
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Convert a complete ANSI colored string to HTML
+/// \param text ANSI colored text
+/// \return HTML fragment (without stylesheet or <pre> wrapper)
+///
+////////////////////////////////////////////////////////////
+std::string AnsiToHtmlString(std::string_view text);
+
+} // namespace conmat
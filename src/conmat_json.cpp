@@ -0,0 +1,236 @@
+#include "conmat_json.h"
+#include "conmat_simd.h"
+#include "conmat_stats_scope.h"
+
+namespace conmat {
+
+namespace {
+
+bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool IsStructural(char c) {
+  return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' ||
+         c == ',';
+}
+
+// Bytes that end a number or literal
+bool EndsBareToken(char c) {
+  unsigned char byte = static_cast<unsigned char>(c);
+  return IsStructural(c) || c == '"' || byte <= 0x20 || byte == 0x7F;
+}
+
+} // anonymous namespace
+
+JsonHighlighter::JsonHighlighter(const JsonOptions &options)
+    : indent_(options.indent) {
+  const FormatOptions *kinds[kKindCount] = {
+      &options.key, &options.string, &options.number, &options.literal,
+      &options.punctuation};
+  for (size_t kind = 0; kind < kKindCount; ++kind) {
+    // Formatting empty text yields exactly the escape codes
+    FormatOptions codes = *kinds[kind];
+    codes.reset_after = false;
+    FormatTo(prefix_[kind], "", codes);
+    if (!prefix_[kind].empty() && kinds[kind]->reset_after) {
+      FormatOptions reset;
+      FormatTo(suffix_[kind], "", reset);
+    }
+  }
+}
+
+void JsonHighlighter::Feed(std::string_view chunk, std::string &out) {
+  CONMAT_STATS_SCOPE(stats::Api::Json, chunk.size());
+  [[maybe_unused]] size_t start = out.size();
+  const char *pos = chunk.data();
+  const char *end = pos + chunk.size();
+
+  while (pos < end) {
+    switch (state_) {
+    case State::Between: {
+      char c = *pos++;
+      if (IsJsonWhitespace(c)) {
+        break;
+      }
+      if (IsStructural(c)) {
+        AppendStructural(c, out);
+      } else if (c == '"') {
+        BeginValue(out);
+        bool is_key = expect_key_ && !containers_.empty() &&
+                      containers_.back() == '{';
+        expect_key_ = false;
+        Open(is_key ? Key : String, out);
+        out.push_back('"');
+        state_ = State::String;
+      } else if (!EndsBareToken(c)) {
+        BeginValue(out);
+        expect_key_ = false;
+        Open(c == '-' || (c >= '0' && c <= '9') ? Number : Literal, out);
+        out.push_back(c);
+        state_ = State::Bare;
+      }
+      // Other control characters are dropped
+      break;
+    }
+
+    case State::String: {
+      const char *stop = detail::FindStringDelimiter(pos, end);
+      out.append(pos, stop);
+      pos = stop;
+      if (pos == end) {
+        break;
+      }
+      char c = *pos++;
+      if (c == '"') {
+        out.push_back('"');
+        Close(out);
+        EndValue();
+        state_ = State::Between;
+      } else if (c == '\\') {
+        out.push_back('\\');
+        state_ = State::StringEscape;
+      }
+      // Raw control characters inside strings are dropped
+      break;
+    }
+
+    case State::StringEscape: {
+      unsigned char c = static_cast<unsigned char>(*pos++);
+      if (c >= 0x20 && c != 0x7F) {
+        out.push_back(static_cast<char>(c));
+      }
+      state_ = State::String;
+      break;
+    }
+
+    case State::Bare: {
+      const char *run = pos;
+      while (pos < end && !EndsBareToken(*pos)) {
+        ++pos;
+      }
+      out.append(run, pos);
+      if (pos != end) {
+        // The delimiter is handled in the Between state
+        Close(out);
+        EndValue();
+        state_ = State::Between;
+      }
+      break;
+    }
+    }
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void JsonHighlighter::Finish(std::string &out) {
+  if (state_ != State::Between) {
+    Close(out);
+    EndValue();
+  }
+  if (value_written_ || !containers_.empty()) {
+    out.push_back('\n');
+  }
+  containers_.clear();
+  state_ = State::Between;
+  expect_key_ = false;
+  open_pending_ = false;
+  value_written_ = false;
+}
+
+void JsonHighlighter::BeginValue(std::string &out) {
+  if (open_pending_) {
+    open_pending_ = false;
+    AppendNewline(out);
+  } else if (containers_.empty() && value_written_) {
+    // Next top-level value
+    out.push_back('\n');
+    value_written_ = false;
+  }
+}
+
+void JsonHighlighter::EndValue() {
+  if (containers_.empty()) {
+    value_written_ = true;
+  }
+}
+
+void JsonHighlighter::AppendStructural(char c, std::string &out) {
+  switch (c) {
+  case '{':
+  case '[':
+    BeginValue(out);
+    AppendPunctuation(c, out);
+    containers_.push_back(c);
+    open_pending_ = true;
+    expect_key_ = c == '{';
+    break;
+
+  case '}':
+  case ']':
+    if (!containers_.empty()) {
+      containers_.pop_back();
+      if (!open_pending_) {
+        AppendNewline(out);
+      }
+    }
+    // Empty containers stay on one line
+    open_pending_ = false;
+    AppendPunctuation(c, out);
+    expect_key_ = false;
+    EndValue();
+    break;
+
+  case ',':
+    AppendPunctuation(c, out);
+    AppendNewline(out);
+    expect_key_ = !containers_.empty() && containers_.back() == '{';
+    break;
+
+  case ':':
+    AppendPunctuation(c, out);
+    if (indent_ != 0) {
+      out.push_back(' ');
+    }
+    expect_key_ = false;
+    break;
+  }
+}
+
+void JsonHighlighter::AppendPunctuation(char c, std::string &out) {
+  Open(Punctuation, out);
+  out.push_back(c);
+  Close(out);
+}
+
+void JsonHighlighter::AppendNewline(std::string &out) {
+  if (indent_ == 0) {
+    return;
+  }
+  size_t width = containers_.size() * indent_;
+  if (spaces_.size() < width) {
+    spaces_.append(Indent(width - spaces_.size(), 1));
+  }
+  out.push_back('\n');
+  out.append(spaces_, 0, width);
+}
+
+void JsonHighlighter::Open(Kind kind, std::string &out) {
+  out.append(prefix_[kind]);
+  open_kind_ = kind;
+}
+
+void JsonHighlighter::Close(std::string &out) {
+  out.append(suffix_[open_kind_]);
+}
+
+std::string HighlightJson(std::string_view json, const JsonOptions &options) {
+  std::string result;
+  result.reserve(json.size() + json.size() / 2);
+  JsonHighlighter highlighter(options);
+  highlighter.Feed(json, result);
+  highlighter.Finish(result);
+  return result;
+}
+
+} // namespace conmat
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "conmat.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Token colors and layout for JsonHighlighter
+///
+////////////////////////////////////////////////////////////
+struct JsonOptions {
+  FormatOptions key{Color::Blue, Color::Default, Style::Bold};
+  FormatOptions string{Color::Green};
+  FormatOptions number{Color::Cyan};
+  FormatOptions literal{Color::Yellow}; // true, false and null
+  FormatOptions punctuation{};
+  size_t indent = 2; // Spaces per nesting level, 0 for single-line output
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming JSON syntax highlighter and pretty-printer
+///
+/// Re-indents JSON fed in arbitrary chunks and colors every token in a
+/// single pass, without building a document tree: the only state kept
+/// is the stack of open containers, so memory use is proportional to
+/// the nesting depth. The escape prefix of each token kind is computed
+/// once, string contents are copied in runs found with a vectorized
+/// scan, and output goes straight into the caller's buffer (for example
+/// BufferedSink::buffer()).
+///
+/// Input whitespace is replaced by the configured layout. Several
+/// top-level values (JSON Lines) are written one per line. The input is
+/// not validated; unexpected bytes are highlighted as literals and
+/// control characters are dropped.
+///
+/// \example
+/// JsonHighlighter highlighter;
+/// std::string out;
+/// highlighter.Feed("{\"id\": 7, \"tags\": [\"a\"]}", out);
+/// highlighter.Finish(out);
+/// // {
+/// //   "id": 7,
+/// //   "tags": [
+/// //     "a"
+/// //   ]
+/// // }
+///
+////////////////////////////////////////////////////////////
+class JsonHighlighter {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a highlighter
+  /// \param options Token colors and indentation
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit JsonHighlighter(const JsonOptions &options = {});
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Highlight the next chunk of input
+  /// \param chunk JSON text, tokens may span chunks
+  /// \param out String the highlighted text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Feed(std::string_view chunk, std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Close any unfinished token, end the line and reset
+  /// \param out String the remaining output is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Finish(std::string &out);
+
+private:
+  enum class State : uint8_t { Between, String, StringEscape, Bare };
+  enum Kind : uint8_t { Key, String, Number, Literal, Punctuation, kKindCount };
+
+  void BeginValue(std::string &out);
+  void EndValue();
+  void AppendStructural(char c, std::string &out);
+  void AppendPunctuation(char c, std::string &out);
+  void AppendNewline(std::string &out);
+  void Open(Kind kind, std::string &out);
+  void Close(std::string &out);
+
+  std::string prefix_[kKindCount]; // Escape codes that start each kind
+  std::string suffix_[kKindCount]; // Reset after each kind, if any
+  std::string containers_;         // '{' or '[' for every open container
+  std::string spaces_;             // Indentation of the deepest line so far
+  size_t indent_;
+  State state_ = State::Between;
+  Kind open_kind_ = Punctuation;
+  bool expect_key_ = false;    // Next string in an object is a key
+  bool open_pending_ = false;  // Container opened, no element seen yet
+  bool value_written_ = false; // A top-level value was completed
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Highlight and pretty-print a complete JSON document
+/// \param json JSON text
+/// \param options Token colors and indentation
+/// \return Highlighted text ending with a newline
+///
+////////////////////////////////////////////////////////////
+std::string HighlightJson(std::string_view json,
+                          const JsonOptions &options = {});
+
+} // namespace conmat
@@ -0,0 +1,251 @@
+#include "conmat_panel.h"
+#include "conmat_ansi.h"
+#include "conmat_codes.h"
+#include "conmat_stats_scope.h"
+#include "conmat_text.h"
+#include <algorithm>
+
+namespace conmat {
+
+namespace {
+
+struct BorderGlyphs {
+  std::string_view top_left;
+  std::string_view top_right;
+  std::string_view bottom_left;
+  std::string_view bottom_right;
+  std::string_view horizontal;
+  std::string_view vertical;
+};
+
+BorderGlyphs GlyphsOf(BorderStyle style) {
+  switch (style) {
+  case BorderStyle::Heavy:
+    return {"┏", "┓", "┗", "┛", "━", "┃"};
+  case BorderStyle::Double:
+    return {"╔", "╗", "╚", "╝", "═", "║"};
+  case BorderStyle::Rounded:
+    return {"╭", "╮", "╰", "╯", "─", "│"};
+  case BorderStyle::Light:
+    break;
+  }
+  return {"┌", "┐", "└", "┘", "─", "│"};
+}
+
+bool HasFormatting(const FormatOptions &options) {
+  return options.foreground != Color::Default ||
+         options.background != Color::Default ||
+         options.style != Style::Default;
+}
+
+// Escape codes selecting a formatting, empty for the default
+std::string CodesOf(const FormatOptions &options) {
+  std::string codes;
+  if (HasFormatting(options)) {
+    FormatOptions open = options;
+    open.reset_after = false;
+    FormatTo(codes, "", open);
+  }
+  return codes;
+}
+
+void AppendRepeated(std::string &out, std::string_view glyph, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    out.append(glyph);
+  }
+}
+
+// Append text without any control character. Unlike Sanitize() this
+// also drops tab and carriage return, which take no columns in
+// DisplayWidth() but would move the cursor across the row.
+void AppendPrintable(std::string &out, std::string_view text) {
+  size_t run = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    unsigned char byte = static_cast<unsigned char>(text[i]);
+    if (byte < 0x20 || byte == 0x7F) {
+      out.append(text, run, i - run);
+      run = i + 1;
+    }
+  }
+  out.append(text, run);
+}
+
+// Append text keeping SGR sequences and dropping every other escape
+// sequence and control character; returns whether SGR was kept
+bool AppendSgrText(std::string &out, std::string_view text) {
+  bool styled = false;
+  for (const AnsiToken &token : AnsiTokenizer(text)) {
+    if (token.kind == AnsiTokenKind::Text) {
+      AppendPrintable(out, token.text);
+    } else if (token.kind == AnsiTokenKind::Sgr && token.complete) {
+      out.append(token.text);
+      styled = true;
+    }
+  }
+  return styled;
+}
+
+// Call line for every '\n' separated line of text; a final line break
+// does not start another line
+template <typename Function>
+void ForEachLine(std::string_view text, Function &&line) {
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    line(text.substr(0, end));
+    if (end == std::string_view::npos) {
+      break;
+    }
+    text.remove_prefix(end + 1);
+  }
+}
+
+} // anonymous namespace
+
+Panel::Panel(const PanelOptions &options, std::string_view title)
+    : width_(std::max(options.width, 2 * options.padding + 2)),
+      inner_width_(width_ - 2 * options.padding - 2) {
+  BorderGlyphs glyphs = GlyphsOf(options.border_style);
+  std::string border_codes = CodesOf(options.border);
+  std::string_view border_reset =
+      border_codes.empty() ? std::string_view() : detail::RESET;
+  body_codes_ = CodesOf(options.body);
+  size_t span = width_ - 2; // Columns between the corners
+
+  // Top row: the title centered like Header(), at least one horizontal
+  // glyph on each side
+  std::string safe_title;
+  if (span >= 5) {
+    std::string printable;
+    AppendPrintable(printable, title);
+    TruncateTo(safe_title, printable, span - 4);
+  }
+  size_t title_width = DisplayWidth(safe_title);
+  top_.append(border_codes);
+  top_.append(glyphs.top_left);
+  if (title_width == 0) {
+    AppendRepeated(top_, glyphs.horizontal, span);
+  } else {
+    size_t fill = span - title_width - 2;
+    AppendRepeated(top_, glyphs.horizontal, fill / 2);
+    top_.push_back(' ');
+    const FormatOptions &title_options =
+        HasFormatting(options.title) ? options.title : options.border;
+    if (HasFormatting(title_options)) {
+      // The title's own codes replace the border's until the reset
+      top_.append(detail::RESET);
+      FormatTo(top_, safe_title, title_options);
+      top_.append(border_codes);
+    } else {
+      top_.append(safe_title);
+    }
+    top_.push_back(' ');
+    AppendRepeated(top_, glyphs.horizontal, fill - fill / 2);
+  }
+  top_.append(glyphs.top_right);
+  top_.append(border_reset);
+  top_.push_back('\n');
+
+  bottom_.append(border_codes);
+  bottom_.append(glyphs.bottom_left);
+  AppendRepeated(bottom_, glyphs.horizontal, span);
+  bottom_.append(glyphs.bottom_right);
+  bottom_.append(border_reset);
+  bottom_.push_back('\n');
+
+  // Body rows: everything but the text and its fill
+  left_.append(border_codes);
+  left_.append(glyphs.vertical);
+  left_.append(border_reset);
+  left_.append(body_codes_);
+  left_.append(options.padding, ' ');
+
+  right_.append(options.padding, ' ');
+  if (!body_codes_.empty()) {
+    right_.append(detail::RESET);
+  }
+  right_.append(border_codes);
+  right_.append(glyphs.vertical);
+  right_.append(border_reset);
+  right_.push_back('\n');
+}
+
+void Panel::LineTo(std::string &out, std::string_view text) const {
+  LineTo(out, text, DisplayWidth(text));
+}
+
+void Panel::LineTo(std::string &out, std::string_view text,
+                   size_t columns) const {
+  out.append(left_);
+  AppendBody(out, text, columns);
+  out.append(right_);
+}
+
+void Panel::RenderTo(std::string &out, std::string_view body) const {
+  CONMAT_STATS_SCOPE(stats::Api::Panel, body.size());
+  [[maybe_unused]] size_t start = out.size();
+  out.append(top_);
+  ForEachLine(body, [&](std::string_view line) { LineTo(out, line); });
+  out.append(bottom_);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void Panel::RenderTo(std::string &out, const Panel &inner,
+                     std::string_view inner_body) const {
+  CONMAT_STATS_SCOPE(stats::Api::Panel, inner_body.size());
+  [[maybe_unused]] size_t start = out.size();
+  out.append(top_);
+  if (inner.width_ > inner_width_) {
+    std::string rendered = inner.Render(inner_body);
+    ForEachLine(rendered, [&](std::string_view line) { LineTo(out, line); });
+  } else {
+    // Every inner row is inner.width() columns: wrap it in this panel's
+    // row parts in place of its line break
+    auto nest = [&](auto &&write_row) {
+      out.append(left_);
+      out.append(body_codes_.empty() ? std::string_view() : detail::RESET);
+      write_row();
+      out.pop_back();
+      out.append(body_codes_);
+      out.append(inner_width_ - inner.width_, ' ');
+      out.append(right_);
+    };
+    nest([&] { inner.TopTo(out); });
+    ForEachLine(inner_body, [&](std::string_view line) {
+      nest([&] { inner.LineTo(out, line); });
+    });
+    nest([&] { inner.BottomTo(out); });
+  }
+  out.append(bottom_);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+std::string Panel::Render(std::string_view body) const {
+  std::string result;
+  size_t rows = 2 + static_cast<size_t>(
+                        std::count(body.begin(), body.end(), '\n')) + 1;
+  result.reserve(top_.size() + bottom_.size() + body.size() +
+                 rows * (left_.size() + right_.size() + inner_width_));
+  RenderTo(result, body);
+  return result;
+}
+
+void Panel::AppendBody(std::string &out, std::string_view text,
+                       size_t columns) const {
+  bool styled;
+  if (columns <= inner_width_) {
+    styled = AppendSgrText(out, text);
+  } else {
+    std::string truncated;
+    TruncateTo(truncated, text, inner_width_);
+    styled = AppendSgrText(out, truncated);
+    columns = DisplayWidth(truncated);
+  }
+  if (styled) {
+    // Keep styles set by the text out of the fill and the border
+    out.append(detail::RESET);
+    out.append(body_codes_);
+  }
+  out.append(inner_width_ - std::min(columns, inner_width_), ' ');
+}
+
+} // namespace conmat
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "conmat.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Box-drawing character set of a Panel border
+///
+////////////////////////////////////////////////////////////
+enum class BorderStyle : uint8_t {
+  Light,  // ┌─┐
+  Heavy,  // ┏━┓
+  Double, // ╔═╗
+  Rounded // ╭─╮
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Layout and formatting of a Panel
+///
+////////////////////////////////////////////////////////////
+struct PanelOptions {
+  BorderStyle border_style = BorderStyle::Light;
+  size_t width = 80;  // Outer width in columns, borders included
+  size_t padding = 1; // Spaces between the side borders and the body
+  FormatOptions border; // Border characters
+  FormatOptions title;  // Title; the border formatting if left default
+  FormatOptions body;   // Body text and the space around it
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Framed box with an optional title in the top border
+///
+/// The border rows and the fixed left and right parts of every body row
+/// are built once, with their escape codes, when the panel is created;
+/// rendering only copies them around the body text, so a panel can be
+/// reused for any number of bodies without rebuilding its geometry.
+///
+/// The title is centered in the top border like Header(). Body lines are
+/// padded to the inner width by display width, so wide characters and
+/// SGR sequences keep the right border aligned; longer lines are
+/// truncated with an ellipsis. SGR sequences in the body are kept, other
+/// escape sequences and control characters are removed.
+///
+/// Every row of a panel is exactly width() columns, so a nested panel is
+/// written row by row into its parent without measuring it again.
+///
+/// \example
+/// Panel panel({.border_style = BorderStyle::Rounded, .width = 24}, "Build");
+/// std::string out = panel.Render("3 targets\n0 errors");
+/// // ╭─────── Build ────────╮
+/// // │ 3 targets            │
+/// // │ 0 errors             │
+/// // ╰──────────────────────╯
+///
+////////////////////////////////////////////////////////////
+class Panel {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Build the border rows
+  /// \param options Border style, width, padding and formatting
+  /// \param title Text embedded in the top border, sanitized
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit Panel(const PanelOptions &options = {},
+                 std::string_view title = {});
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append the top border row
+  ///
+  ////////////////////////////////////////////////////////////
+  void TopTo(std::string &out) const { out.append(top_); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append the bottom border row
+  ///
+  ////////////////////////////////////////////////////////////
+  void BottomTo(std::string &out) const { out.append(bottom_); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append one body row
+  /// \param out String the row is appended to
+  /// \param text One line of text, without line breaks
+  ///
+  ////////////////////////////////////////////////////////////
+  void LineTo(std::string &out, std::string_view text) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append one body row of known display width
+  ///
+  /// Skips measuring text; columns must be its DisplayWidth().
+  ///
+  ////////////////////////////////////////////////////////////
+  void LineTo(std::string &out, std::string_view text, size_t columns) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append the whole panel
+  /// \param out String the panel is appended to
+  /// \param body Text with one row per line
+  ///
+  ////////////////////////////////////////////////////////////
+  void RenderTo(std::string &out, std::string_view body) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append the whole panel with another panel as its body
+  ///
+  /// The inner panel's rows are copied between this panel's borders
+  /// without being measured. An inner panel wider than inner_width() is
+  /// rendered first and its rows truncated.
+  ///
+  /// \param out String the panels are appended to
+  /// \param inner Panel drawn inside this one
+  /// \param inner_body Body of the inner panel
+  ///
+  ////////////////////////////////////////////////////////////
+  void RenderTo(std::string &out, const Panel &inner,
+                std::string_view inner_body) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Render the whole panel
+  /// \param body Text with one row per line
+  /// \return The panel, one '\n'-terminated row per line
+  ///
+  ////////////////////////////////////////////////////////////
+  std::string Render(std::string_view body) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Columns of every row
+  ///
+  ////////////////////////////////////////////////////////////
+  size_t width() const { return width_; }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Columns available to the body text of a row
+  ///
+  ////////////////////////////////////////////////////////////
+  size_t inner_width() const { return inner_width_; }
+
+private:
+  void AppendBody(std::string &out, std::string_view text,
+                  size_t columns) const;
+
+  std::string top_;    // Whole top row with its line break
+  std::string bottom_; // Whole bottom row with its line break
+  std::string left_;   // Border, padding and body codes before the text
+  std::string right_;  // Body reset, padding, border and line break
+  std::string body_codes_; // Codes of the body formatting, may be empty
+  size_t width_;
+  size_t inner_width_;
+};
+
+} // namespace conmat
@@ -0,0 +1,376 @@
+#include "conmat_profile.h"
+#include "conmat.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace conmat::profile {
+
+namespace {
+
+struct Event {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// Events are appended by the owning thread only. The count and the link
+// to the next block are published with release stores, so a report can
+// walk the log while the thread keeps recording.
+struct Block {
+  static constexpr size_t kEvents = 1024;
+
+  Event events[kEvents];
+  std::atomic<size_t> count{0};
+  std::atomic<Block *> next{nullptr};
+};
+
+struct ThreadLog {
+  Block head;
+  Block *tail = &head; // Only used by the owning thread
+  uint32_t id = 0;
+
+  void FreeBlocks() {
+    Block *block = head.next.exchange(nullptr, std::memory_order_relaxed);
+    while (block != nullptr) {
+      Block *next = block->next.load(std::memory_order_relaxed);
+      delete block;
+      block = next;
+    }
+    head.count.store(0, std::memory_order_relaxed);
+    tail = &head;
+  }
+
+  ~ThreadLog() { FreeBlocks(); }
+};
+
+// Logs outlive their threads so scopes timed on workers can be reported
+// after they are joined
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadLog>> logs;
+  // Clock readings at startup, for converting ticks to nanoseconds
+  uint64_t start_ticks = Now();
+  std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+};
+
+Registry &GetRegistry() {
+  // Never destroyed, so threads may record during static destruction
+  static Registry *registry = new Registry;
+  return *registry;
+}
+
+// Returns nullptr if the log cannot be allocated or the registry locked;
+// Record() runs in destructors and must not throw
+ThreadLog *RegisterThread() noexcept {
+  try {
+    Registry &registry = GetRegistry();
+    std::lock_guard lock(registry.mutex);
+    auto log = std::make_unique<ThreadLog>();
+    log->id = static_cast<uint32_t>(registry.logs.size());
+    registry.logs.push_back(std::move(log));
+    return registry.logs.back().get();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+// Calibrate the clock against steady_clock over the whole run; wait for
+// at least a millisecond so short runs still get a usable ratio
+double NanosecondsPerTick(const Registry &registry) {
+  using namespace std::chrono;
+  steady_clock::time_point now = steady_clock::now();
+  while (now - registry.start_time < milliseconds(1)) {
+    now = steady_clock::now();
+  }
+  uint64_t ticks = Now() - registry.start_ticks;
+  double elapsed =
+      static_cast<double>(duration_cast<nanoseconds>(now - registry.start_time)
+                              .count());
+  return ticks != 0 ? elapsed / static_cast<double>(ticks) : 1.0;
+}
+
+void CollectEvents(const ThreadLog &log, std::vector<Event> &events) {
+  for (const Block *block = &log.head; block != nullptr;
+       block = block->next.load(std::memory_order_acquire)) {
+    size_t count = block->count.load(std::memory_order_acquire);
+    events.insert(events.end(), block->events, block->events + count);
+  }
+}
+
+CallNode &ChildNamed(CallNode &parent, const char *name) {
+  std::string_view key(name);
+  for (CallNode &child : parent.children) {
+    if (child.name.data() == name || child.name == key) {
+      return child;
+    }
+  }
+  parent.children.push_back({});
+  parent.children.back().name = key;
+  return parent.children.back();
+}
+
+void Finalize(CallNode &node) {
+  double children = 0.0;
+  for (CallNode &child : node.children) {
+    Finalize(child);
+    children += child.total_ns;
+  }
+  node.self_ns = std::max(node.total_ns - children, 0.0);
+  std::stable_sort(node.children.begin(), node.children.end(),
+                   [](const CallNode &a, const CallNode &b) {
+                     return a.total_ns > b.total_ns;
+                   });
+}
+
+void AppendFixed(std::string &out, double value, int precision) {
+  char buffer[32];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                              std::chars_format::fixed, precision);
+  out.append(buffer, result.ptr);
+}
+
+// Append text right-aligned in a column of width characters
+void AppendRight(std::string &out, std::string_view text, size_t width,
+                 const FormatOptions &options = {}) {
+  if (text.size() < width) {
+    out.append(width - text.size(), ' ');
+  }
+  if (options.foreground == Color::Default) {
+    out.append(text);
+  } else {
+    FormatTo(out, text, options);
+  }
+}
+
+std::string Percent(double part, double whole) {
+  std::string text;
+  AppendFixed(text, whole > 0.0 ? 100.0 * part / whole : 0.0, 1);
+  text.push_back('%');
+  return text;
+}
+
+std::string Duration(double ns) {
+  struct Unit {
+    double scale;
+    std::string_view suffix;
+  };
+  constexpr Unit kUnits[] = {{1e9, " s"}, {1e6, " ms"}, {1e3, " us"}};
+  std::string text;
+  for (const Unit &unit : kUnits) {
+    if (ns >= unit.scale) {
+      AppendFixed(text, ns / unit.scale, 1);
+      text.append(unit.suffix);
+      return text;
+    }
+  }
+  AppendFixed(text, ns, 0);
+  text.append(" ns");
+  return text;
+}
+
+void AppendRows(std::string &out, const CallNode &node, size_t depth,
+                double total, const ReportOptions &options) {
+  for (const CallNode &child : node.children) {
+    double share = total > 0.0 ? 100.0 * child.total_ns / total : 0.0;
+    if (share < options.min_percent) {
+      continue;
+    }
+    double self_share = total > 0.0 ? 100.0 * child.self_ns / total : 0.0;
+    Color heat = self_share >= options.hot_percent    ? Color::Red
+                 : self_share >= options.warm_percent ? Color::Yellow
+                                                      : Color::Default;
+    char calls[24];
+    auto calls_end = std::to_chars(calls, calls + sizeof(calls), child.calls);
+
+    out.append(Indent(1));
+    AppendRight(out, Percent(child.total_ns, total), 7);
+    AppendRight(out, Percent(child.self_ns, total), 8, heat);
+    AppendRight(out, Duration(child.total_ns), 12);
+    AppendRight(out, std::string_view(calls, calls_end.ptr), 10);
+    out.append("  ");
+    out.append(Indent(depth));
+    conmat::detail::AppendSanitized(out, child.name);
+    out.push_back('\n');
+    AppendRows(out, child, depth + 1, total, options);
+  }
+}
+
+void AppendJsonString(std::string &out, std::string_view text) {
+  constexpr char kHex[] = "0123456789abcdef";
+  out.push_back('"');
+  for (char c : text) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (byte < 0x20) {
+      out.append("\\u00");
+      out.push_back(kHex[byte >> 4]);
+      out.push_back(kHex[byte & 0xF]);
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+uint64_t SteadyTicks() noexcept {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void Record(const char *name, uint64_t begin, uint64_t end) noexcept {
+  thread_local ThreadLog *log = nullptr;
+  if (log == nullptr) {
+    log = RegisterThread();
+    if (log == nullptr) {
+      return; // Registration failed: drop the event, retry next time
+    }
+  }
+
+  Block *block = log->tail;
+  size_t count = block->count.load(std::memory_order_relaxed);
+  if (count == Block::kEvents) {
+    Block *next = new (std::nothrow) Block;
+    if (next == nullptr) {
+      return; // Out of memory: drop the event
+    }
+    block->next.store(next, std::memory_order_release);
+    log->tail = block = next;
+    count = 0;
+  }
+  block->events[count] = {name, begin, end};
+  block->count.store(count + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+CallNode CallTree() {
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  double scale = NanosecondsPerTick(registry);
+
+  CallNode root;
+  std::vector<Event> events;
+  std::vector<std::pair<uint64_t, CallNode *>> open; // End tick, node
+  for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+    events.clear();
+    CollectEvents(*log, events);
+    // Parents start no later and end no earlier than their children
+    std::sort(events.begin(), events.end(),
+              [](const Event &a, const Event &b) {
+                return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+              });
+
+    open.clear();
+    for (const Event &event : events) {
+      while (!open.empty() && event.end > open.back().first) {
+        open.pop_back();
+      }
+      CallNode &parent = open.empty() ? root : *open.back().second;
+      CallNode &node = ChildNamed(parent, event.name);
+      ++node.calls;
+      node.total_ns += static_cast<double>(event.end - event.begin) * scale;
+      open.emplace_back(event.end, &node);
+    }
+  }
+
+  for (const CallNode &child : root.children) {
+    root.total_ns += child.total_ns;
+  }
+  Finalize(root);
+  return root;
+}
+
+void Reset() {
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+    log->FreeBlocks();
+  }
+}
+
+void ReportTo(std::string &out, const CallNode &tree,
+              const ReportOptions &options) {
+  out.append(Header("profile", 2, options.width));
+  out.push_back('\n');
+  if (tree.children.empty()) {
+    out.append(Indent(1));
+    out.append("no scopes recorded\n");
+    return;
+  }
+
+  out.append(Indent(1));
+  AppendRight(out, "total", 7);
+  AppendRight(out, "self", 8);
+  AppendRight(out, "time", 12);
+  AppendRight(out, "calls", 10);
+  out.append("  scope\n");
+  AppendRows(out, tree, 0, tree.total_ns, options);
+}
+
+std::string Report(const CallNode &tree, const ReportOptions &options) {
+  std::string result;
+  ReportTo(result, tree, options);
+  return result;
+}
+
+void ChromeTraceTo(std::string &out) {
+  Registry &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  double us_per_tick = NanosecondsPerTick(registry) / 1000.0;
+
+  std::vector<std::vector<Event>> threads(registry.logs.size());
+  uint64_t origin = UINT64_MAX;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CollectEvents(*registry.logs[i], threads[i]);
+    for (const Event &event : threads[i]) {
+      origin = std::min(origin, event.begin);
+    }
+  }
+
+  out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    char tid[16];
+    auto tid_end =
+        std::to_chars(tid, tid + sizeof(tid), registry.logs[i]->id);
+    for (const Event &event : threads[i]) {
+      out.append(first ? "\n" : ",\n");
+      first = false;
+      out.append("{\"name\":");
+      AppendJsonString(out, event.name);
+      out.append(",\"ph\":\"X\",\"pid\":1,\"tid\":");
+      out.append(tid, tid_end.ptr);
+      out.append(",\"ts\":");
+      AppendFixed(out, static_cast<double>(event.begin - origin) * us_per_tick,
+                  3);
+      out.append(",\"dur\":");
+      AppendFixed(out, static_cast<double>(event.end - event.begin) *
+                           us_per_tick,
+                  3);
+      out.push_back('}');
+    }
+  }
+  out.append("\n]}\n");
+}
+
+std::string ChromeTrace() {
+  std::string result;
+  ChromeTraceTo(result);
+  return result;
+}
+
+} // namespace conmat::profile
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace conmat::profile {
+
+namespace detail {
+uint64_t SteadyTicks() noexcept;
+void Record(const char *name, uint64_t begin, uint64_t end) noexcept;
+} // namespace detail
+
+////////////////////////////////////////////////////////////
+/// \brief Read the profiling clock
+///
+/// The time stamp counter on x86 (monotonic and constant-rate on
+/// current CPUs), std::chrono::steady_clock nanoseconds elsewhere.
+/// Ticks are converted to time when a report is built.
+///
+////////////////////////////////////////////////////////////
+inline uint64_t Now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#else
+  return detail::SteadyTicks();
+#endif
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Times a scope and records it for the calling thread
+///
+/// Recording appends one event to a buffer owned by the thread; no lock
+/// is taken except the first time a thread records. The name is stored
+/// as a pointer, so it must outlive the report (use string literals).
+///
+/// \example
+/// void Load() {
+///   CONMAT_PROFILE_SCOPE("load");
+///   { CONMAT_PROFILE_SCOPE("parse"); Parse(); }
+/// }
+///
+////////////////////////////////////////////////////////////
+class ScopedTimer {
+public:
+  explicit ScopedTimer(const char *name) noexcept
+      : name_(name), begin_(Now()) {}
+  ~ScopedTimer() { detail::Record(name_, begin_, Now()); }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  const char *name_;
+  uint64_t begin_;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Scope timings aggregated by call path
+///
+/// Times are summed over all calls and all threads. The root node has
+/// an empty name; its total is the sum of the top-level scopes.
+///
+////////////////////////////////////////////////////////////
+struct CallNode {
+  std::string_view name;
+  uint64_t calls = 0;
+  double total_ns = 0.0; // Including children
+  double self_ns = 0.0;  // Excluding children
+  std::vector<CallNode> children;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Aggregate the recorded scopes into a call tree
+///
+/// Scopes still running are not included. May be called while other
+/// threads record.
+///
+/// \return Root of the tree, children sorted by total time
+///
+////////////////////////////////////////////////////////////
+CallNode CallTree();
+
+////////////////////////////////////////////////////////////
+/// \brief Discard every recorded scope
+///
+/// Must not run concurrently with ScopedTimer destructors.
+///
+////////////////////////////////////////////////////////////
+void Reset();
+
+////////////////////////////////////////////////////////////
+/// \brief Options for Report()
+///
+////////////////////////////////////////////////////////////
+struct ReportOptions {
+  size_t width = 80;         // Header width
+  double hot_percent = 20.0; // Self time shown red from this share
+  double warm_percent = 5.0; // Self time shown yellow from this share
+  double min_percent = 0.0;  // Scopes below this total share are hidden
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Append a nested timing report under a conmat Header
+/// \param out String the report is appended to
+/// \param tree Tree to render (usually CallTree())
+/// \param options Width, color thresholds and filtering
+///
+////////////////////////////////////////////////////////////
+void ReportTo(std::string &out, const CallNode &tree,
+              const ReportOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Render a nested timing report
+///
+/// One line per call path with its share of the total time, its self
+/// time share (red for hot spots), total time and call count; children
+/// are indented under their parent.
+///
+/// \param tree Tree to render (usually CallTree())
+/// \param options Width, color thresholds and filtering
+/// \return Multi-line report
+///
+////////////////////////////////////////////////////////////
+std::string Report(const CallNode &tree, const ReportOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Append the recorded scopes in Chrome trace event format
+///
+/// Writes one complete ("X") event per scope, with times in
+/// microseconds from the first event and one tid per thread. The result
+/// opens in chrome://tracing and Perfetto.
+///
+/// \param out String the JSON document is appended to
+///
+////////////////////////////////////////////////////////////
+void ChromeTraceTo(std::string &out);
+
+////////////////////////////////////////////////////////////
+/// \brief Export the recorded scopes as Chrome trace JSON
+///
+////////////////////////////////////////////////////////////
+std::string ChromeTrace();
+
+} // namespace conmat::profile
+
+#define CONMAT_PROFILE_CONCAT_(a, b) a##b
+#define CONMAT_PROFILE_NAME_(line) CONMAT_PROFILE_CONCAT_(conmat_profile_, line)
+
+////////////////////////////////////////////////////////////
+/// \brief Time the rest of the enclosing scope under a name
+///
+////////////////////////////////////////////////////////////
+#define CONMAT_PROFILE_SCOPE(name)                                             \
+  ::conmat::profile::ScopedTimer CONMAT_PROFILE_NAME_(__LINE__)(name)
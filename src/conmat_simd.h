@@ -0,0 +1,201 @@
+#pragma once
+
+// Vectorized byte scanners shared by the escape-aware parts of conmat.
+// SSE2 (always available on x86-64) and NEON paths with a scalar fallback.
+
+#include <bit>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONMAT_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CONMAT_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace conmat::detail {
+
+////////////////////////////////////////////////////////////
+/// \brief Check whether Sanitize would remove a byte
+///
+/// Control characters other than '\n', '\t' and '\r' and DEL are
+/// removed; printable ASCII and all bytes >= 0x80 are kept.
+///
+////////////////////////////////////////////////////////////
+inline bool IsUnsafeByte(unsigned char c) {
+  return (c < 32 && c != '\n' && c != '\t' && c != '\r') || c == 127;
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Find the first byte in [begin, end) that Sanitize would remove
+/// \return Pointer to the byte, or end if the range is clean
+///
+////////////////////////////////////////////////////////////
+inline const char *FindUnsafeByte(const char *begin, const char *end) {
+  const char *pos = begin;
+
+#if defined(CONMAT_SIMD_SSE2)
+  const __m128i max_control = _mm_set1_epi8(31);
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i carriage_return = _mm_set1_epi8('\r');
+  const __m128i del = _mm_set1_epi8(127);
+  const __m128i zero = _mm_setzero_si128();
+  for (; end - pos >= 16; pos += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+    // v <= 31 (unsigned) <=> saturating v - 31 == 0
+    __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(v, max_control), zero);
+    __m128i allowed = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, tab)),
+        _mm_cmpeq_epi8(v, carriage_return));
+    __m128i unsafe = _mm_or_si128(_mm_andnot_si128(allowed, control),
+                                  _mm_cmpeq_epi8(v, del));
+    int mask = _mm_movemask_epi8(unsafe);
+    if (mask != 0) {
+      return pos + std::countr_zero(static_cast<unsigned>(mask));
+    }
+  }
+#elif defined(CONMAT_SIMD_NEON)
+  const uint8x16_t max_control = vdupq_n_u8(31);
+  const uint8x16_t newline = vdupq_n_u8('\n');
+  const uint8x16_t tab = vdupq_n_u8('\t');
+  const uint8x16_t carriage_return = vdupq_n_u8('\r');
+  const uint8x16_t del = vdupq_n_u8(127);
+  for (; end - pos >= 16; pos += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(pos));
+    uint8x16_t control = vcleq_u8(v, max_control);
+    uint8x16_t allowed =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, newline), vceqq_u8(v, tab)),
+                 vceqq_u8(v, carriage_return));
+    uint8x16_t unsafe =
+        vorrq_u8(vbicq_u8(control, allowed), vceqq_u8(v, del));
+    if (vmaxvq_u8(unsafe) != 0) {
+      break; // Locate the exact byte with the scalar loop below
+    }
+  }
+#endif
+
+  for (; pos < end; ++pos) {
+    if (IsUnsafeByte(static_cast<unsigned char>(*pos))) {
+      return pos;
+    }
+  }
+  return end;
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Find the first occurrence of a byte in [begin, end)
+///
+/// Usable in constant expressions (scalar loop at compile time).
+///
+/// \return Pointer to the byte, or end if it does not occur
+///
+////////////////////////////////////////////////////////////
+constexpr const char *FindByte(const char *begin, const char *end, char byte) {
+  const char *pos = begin;
+
+  if !consteval {
+#if defined(CONMAT_SIMD_SSE2)
+    const __m128i needle = _mm_set1_epi8(byte);
+    // Two vectors per iteration keeps the loop branch off the critical path
+    for (; end - pos >= 32; pos += 32) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos + 16));
+      int mask_a = _mm_movemask_epi8(_mm_cmpeq_epi8(a, needle));
+      int mask_b = _mm_movemask_epi8(_mm_cmpeq_epi8(b, needle));
+      if ((mask_a | mask_b) != 0) {
+        unsigned mask = static_cast<unsigned>(mask_a) |
+                        (static_cast<unsigned>(mask_b) << 16);
+        return pos + std::countr_zero(mask);
+      }
+    }
+    for (; end - pos >= 16; pos += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+      if (mask != 0) {
+        return pos + std::countr_zero(static_cast<unsigned>(mask));
+      }
+    }
+#elif defined(CONMAT_SIMD_NEON)
+    const uint8x16_t needle = vdupq_n_u8(static_cast<uint8_t>(byte));
+    for (; end - pos >= 16; pos += 16) {
+      uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(pos));
+      if (vmaxvq_u8(vceqq_u8(v, needle)) != 0) {
+        break; // Locate the exact byte with the scalar loop below
+      }
+    }
+#endif
+  }
+
+  for (; pos < end; ++pos) {
+    if (*pos == byte) {
+      return pos;
+    }
+  }
+  return end;
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Find the next ESC (0x1B) byte in [begin, end)
+///
+////////////////////////////////////////////////////////////
+constexpr const char *FindEscape(const char *begin, const char *end) {
+  return FindByte(begin, end, '\033');
+}
+
+////////////////////////////////////////////////////////////
+/// \brief Find the first byte that ends a run of JSON string content
+///
+/// Stops at '"', '\\', control characters (< 0x20) and DEL.
+///
+/// \return Pointer to the byte, or end if the whole range is content
+///
+////////////////////////////////////////////////////////////
+inline const char *FindStringDelimiter(const char *begin, const char *end) {
+  const char *pos = begin;
+
+#if defined(CONMAT_SIMD_SSE2)
+  const __m128i max_control = _mm_set1_epi8(31);
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i del = _mm_set1_epi8(127);
+  const __m128i zero = _mm_setzero_si128();
+  for (; end - pos >= 16; pos += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+    __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(v, max_control), zero);
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_or_si128(control, _mm_cmpeq_epi8(v, del)));
+    int mask = _mm_movemask_epi8(special);
+    if (mask != 0) {
+      return pos + std::countr_zero(static_cast<unsigned>(mask));
+    }
+  }
+#elif defined(CONMAT_SIMD_NEON)
+  const uint8x16_t max_control = vdupq_n_u8(31);
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t del = vdupq_n_u8(127);
+  for (; end - pos >= 16; pos += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(pos));
+    uint8x16_t special =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)),
+                 vorrq_u8(vcleq_u8(v, max_control), vceqq_u8(v, del)));
+    if (vmaxvq_u8(special) != 0) {
+      break; // Locate the exact byte with the scalar loop below
+    }
+  }
+#endif
+
+  for (; pos < end; ++pos) {
+    unsigned char c = static_cast<unsigned char>(*pos);
+    if (c == '"' || c == '\\' || c < 0x20 || c == 0x7F) {
+      return pos;
+    }
+  }
+  return end;
+}
+
+} // namespace conmat::detail
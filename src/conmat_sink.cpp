@@ -0,0 +1,160 @@
+#include "conmat_sink.h"
+#include <cerrno>
+#include <memory>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace conmat {
+
+namespace {
+
+bool AppendToString(void *context, std::string_view data) {
+  static_cast<std::string *>(context)->append(data);
+  return true;
+}
+
+// Pipes, FIFOs and sockets may interleave writes above PIPE_BUF bytes
+bool SplitsLargeWrites(int fd) {
+#if defined(_WIN32)
+  (void)fd;
+  return false;
+#else
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    return true;
+  }
+  return S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode);
+#endif
+}
+
+} // anonymous namespace
+
+bool WriteAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+#if defined(_WIN32)
+    int written = _write(fd, data.data(), static_cast<unsigned>(data.size()));
+#else
+    ssize_t written = ::write(fd, data.data(), data.size());
+#endif
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+BufferedSink::BufferedSink(int fd, size_t capacity)
+    : fd_(fd), capacity_(capacity > 0 ? capacity : 1) {
+  buffer_.reserve(capacity_);
+}
+
+BufferedSink::BufferedSink(std::string &target, size_t capacity)
+    : function_(&AppendToString), context_(&target),
+      capacity_(capacity > 0 ? capacity : 1) {
+  buffer_.reserve(capacity_);
+}
+
+BufferedSink::BufferedSink(FlushFunction function, void *context,
+                           size_t capacity)
+    : function_(function), context_(context),
+      capacity_(capacity > 0 ? capacity : 1) {
+  buffer_.reserve(capacity_);
+}
+
+BufferedSink::~BufferedSink() { Flush(); }
+
+void BufferedSink::Append(std::string_view data) {
+  if (buffer_.size() + data.size() < capacity_) {
+    buffer_.append(data);
+    return;
+  }
+
+  // Large write: drain what is pending and hand the data over directly
+  Flush();
+  if (data.size() >= capacity_) {
+    ok_ = Write(data) && ok_;
+  } else {
+    buffer_.append(data);
+  }
+}
+
+void BufferedSink::Append(size_t count, char c) {
+  while (count > 0) {
+    size_t room = capacity_ > buffer_.size() ? capacity_ - buffer_.size() : 0;
+    size_t n = count < room ? count : room;
+    buffer_.append(n, c);
+    count -= n;
+    if (buffer_.size() >= capacity_) {
+      Flush();
+    }
+  }
+}
+
+bool BufferedSink::Flush() {
+  if (!buffer_.empty()) {
+    ok_ = Write(buffer_) && ok_;
+    buffer_.clear();
+  }
+  return ok_;
+}
+
+bool BufferedSink::Write(std::string_view data) {
+  if (function_ != nullptr) {
+    return function_(context_, data);
+  }
+  return WriteAll(fd_, data);
+}
+
+LineBuffer::LineBuffer(int fd) : fd_(fd), split_(SplitsLargeWrites(fd)) {}
+
+LineBuffer::~LineBuffer() { Commit(); }
+
+bool LineBuffer::Commit() {
+  std::string_view data = buffer_;
+  if (!split_) {
+    ok_ = WriteAll(fd_, data) && ok_;
+    buffer_.clear();
+    return ok_;
+  }
+
+  while (!data.empty()) {
+    // Largest run of whole lines that fits in one atomic write
+    size_t size = data.size();
+    if (size > kAtomicWriteSize) {
+      size_t newline = data.rfind('\n', kAtomicWriteSize - 1);
+      if (newline == std::string_view::npos) {
+        // Over-long line: write it whole, atomicity is not guaranteed
+        newline = data.find('\n', kAtomicWriteSize);
+      }
+      size = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    ok_ = WriteAll(fd_, data.substr(0, size)) && ok_;
+    data.remove_prefix(size);
+  }
+  buffer_.clear();
+  return ok_;
+}
+
+LineBuffer &ThreadLineBuffer(int fd) {
+  // A thread rarely writes to more than stdout and stderr
+  thread_local std::vector<std::unique_ptr<LineBuffer>> buffers;
+  for (const std::unique_ptr<LineBuffer> &buffer : buffers) {
+    if (buffer->fd() == fd) {
+      return *buffer;
+    }
+  }
+  buffers.push_back(std::make_unique<LineBuffer>(fd));
+  return *buffers.back();
+}
+
+} // namespace conmat
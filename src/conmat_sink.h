@@ -0,0 +1,261 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Append-only output buffer that flushes in large blocks
+///
+/// Output is accumulated in an internal string and handed to the target
+/// once the buffer reaches its capacity, so many small appends turn into
+/// a few large writes. Writes larger than the capacity bypass the buffer.
+/// The sink flushes on destruction.
+///
+/// \example
+/// BufferedSink out(1);  // stdout
+/// out.Append(Colorize("ok", Color::Green));
+/// out.Append('\n');
+///
+////////////////////////////////////////////////////////////
+class BufferedSink {
+public:
+  /// \brief Function receiving flushed data, returns false on failure
+  using FlushFunction = bool (*)(void *context, std::string_view data);
+
+  /// \brief Default buffer capacity in bytes
+  static constexpr size_t kDefaultCapacity = size_t{1} << 16;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a sink writing to a file descriptor
+  /// \param fd File descriptor to write to (not closed by the sink)
+  /// \param capacity Buffer size that triggers a flush
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit BufferedSink(int fd, size_t capacity = kDefaultCapacity);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a sink appending to a string
+  /// \param target String that flushed data is appended to
+  /// \param capacity Buffer size that triggers a flush
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit BufferedSink(std::string &target,
+                        size_t capacity = kDefaultCapacity);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a sink handing flushed data to a function
+  /// \param function Called with each flushed block
+  /// \param context Opaque pointer passed to function
+  /// \param capacity Buffer size that triggers a flush
+  ///
+  ////////////////////////////////////////////////////////////
+  BufferedSink(FlushFunction function, void *context,
+               size_t capacity = kDefaultCapacity);
+
+  ~BufferedSink();
+
+  BufferedSink(const BufferedSink &) = delete;
+  BufferedSink &operator=(const BufferedSink &) = delete;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append bytes, flushing if the buffer is full
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(std::string_view data);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a single character, flushing if the buffer is full
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(char c) {
+    buffer_.push_back(c);
+    if (buffer_.size() >= capacity_) {
+      Flush();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append count copies of a character
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(size_t count, char c);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Direct access to the pending buffer
+  ///
+  /// Callers may append to the returned string and then call
+  /// MaybeFlush() to keep the buffer bounded.
+  ///
+  ////////////////////////////////////////////////////////////
+  std::string &buffer() { return buffer_; }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Flush if the pending buffer has reached capacity
+  ///
+  ////////////////////////////////////////////////////////////
+  void MaybeFlush() {
+    if (buffer_.size() >= capacity_) {
+      Flush();
+    }
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Write all pending data to the target
+  /// \return False if this or any earlier write failed
+  ///
+  ////////////////////////////////////////////////////////////
+  bool Flush();
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether every write so far succeeded
+  ///
+  ////////////////////////////////////////////////////////////
+  bool ok() const { return ok_; }
+
+private:
+  bool Write(std::string_view data);
+
+  FlushFunction function_ = nullptr;
+  void *context_ = nullptr;
+  int fd_ = -1;
+  size_t capacity_;
+  std::string buffer_;
+  bool ok_ = true;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Largest write the kernel keeps whole on a pipe
+///
+/// POSIX guarantees that a write of at most PIPE_BUF bytes to a pipe or
+/// FIFO is not interleaved with writes from other threads or processes.
+///
+////////////////////////////////////////////////////////////
+#if defined(PIPE_BUF)
+inline constexpr size_t kAtomicWriteSize = PIPE_BUF;
+#else
+inline constexpr size_t kAtomicWriteSize = 512; // _POSIX_PIPE_BUF
+#endif
+
+////////////////////////////////////////////////////////////
+/// \brief Line buffer that commits whole lines with single writes
+///
+/// Each thread collects a line, or a group of lines such as a Header and
+/// its rows, and Commit() hands it to the kernel in one write(2) so that
+/// output of concurrent threads never interleaves mid-line. No lock is
+/// taken: a buffer belongs to one thread (see ThreadLineBuffer()), and
+/// since a thread's commits are sequential writes they stay in order.
+///
+/// On a pipe, FIFO or socket a single write is only atomic up to
+/// kAtomicWriteSize bytes, so larger commits are split at line breaks
+/// into writes of at most that size; each line then stays whole, but
+/// lines of another thread may appear between them. A single line longer
+/// than kAtomicWriteSize has no atomicity guarantee on a pipe. Terminals
+/// and regular files receive every commit as one write.
+///
+/// Nothing is written before Commit(); the destructor commits what is
+/// pending.
+///
+/// \example
+/// LineBuffer &out = ThreadLineBuffer(1);  // this thread's stdout buffer
+/// out.Append(Header("results"));
+/// out.Append('\n');
+/// out.Append(row);
+/// out.Append('\n');
+/// out.Commit();
+///
+////////////////////////////////////////////////////////////
+class LineBuffer {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a buffer committing to a file descriptor
+  /// \param fd File descriptor to write to (not closed by the buffer)
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit LineBuffer(int fd);
+
+  ~LineBuffer();
+
+  LineBuffer(const LineBuffer &) = delete;
+  LineBuffer &operator=(const LineBuffer &) = delete;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append bytes to the pending group
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(std::string_view data) { buffer_.append(data); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append a single character to the pending group
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(char c) { buffer_.push_back(c); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append count copies of a character to the pending group
+  ///
+  ////////////////////////////////////////////////////////////
+  void Append(size_t count, char c) { buffer_.append(count, c); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Direct access to the pending group, e.g. for FormatTo()
+  ///
+  ////////////////////////////////////////////////////////////
+  std::string &buffer() { return buffer_; }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Write the pending group and start a new one
+  /// \return False if this or any earlier write failed
+  ///
+  ////////////////////////////////////////////////////////////
+  bool Commit();
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Drop the pending group without writing it
+  ///
+  ////////////////////////////////////////////////////////////
+  void Discard() { buffer_.clear(); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Check whether every commit so far succeeded
+  ///
+  ////////////////////////////////////////////////////////////
+  bool ok() const { return ok_; }
+
+  int fd() const { return fd_; }
+
+private:
+  int fd_;
+  bool split_; // Target only keeps kAtomicWriteSize bytes whole
+  std::string buffer_;
+  bool ok_ = true;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Get the calling thread's line buffer for a file descriptor
+///
+/// The buffer is created on first use and committed when the thread
+/// exits. Lookups only touch thread-local data.
+///
+/// \param fd File descriptor the buffer writes to
+/// \return The calling thread's buffer for fd
+///
+////////////////////////////////////////////////////////////
+LineBuffer &ThreadLineBuffer(int fd = 1);
+
+////////////////////////////////////////////////////////////
+/// \brief Write a whole buffer to a file descriptor
+///
+/// Retries on partial writes and EINTR.
+///
+/// \param fd File descriptor to write to
+/// \param data Bytes to write
+/// \return True if every byte was written
+///
+////////////////////////////////////////////////////////////
+bool WriteAll(int fd, std::string_view data);
+
+} // namespace conmat
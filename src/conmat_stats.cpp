@@ -0,0 +1,181 @@
+#include "conmat_stats.h"
+#include "conmat.h"
+#include "conmat_stats_scope.h"
+#include <atomic>
+#include <charconv>
+
+namespace conmat::stats {
+
+namespace {
+
+constexpr std::string_view kApiNames[kApiCount] = {
+    "FormatImpl",   "FormatTo",   "Divider",      "Header",
+    "Indent",       "Sanitize",   "SanitizeView", "StripAnsi",
+    "AnsiStripper", "AnsiToHtml", "Wrap",         "Tree",
+    "Diff",         "Json",       "Gradient",     "Chart",
+    "StyledString", "Truncate",   "SanitizeSgr",  "Panel"};
+
+// Append value right-aligned in a column of width characters
+void AppendColumn(std::string &out, uint64_t value, size_t width) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  size_t length = static_cast<size_t>(result.ptr - digits);
+  if (length < width) {
+    out.append(width - length, ' ');
+  }
+  out.append(digits, length);
+}
+
+void AppendColumn(std::string &out, std::string_view text, size_t width) {
+  out.append(text);
+  if (text.size() < width) {
+    out.append(width - text.size(), ' ');
+  }
+}
+
+#if CONMAT_ENABLE_STATS
+
+enum Field {
+  Calls,
+  InputBytes,
+  OutputBytes,
+  EscapeBytes,
+  Allocations,
+  kFieldCount
+};
+
+// Threads are spread over shards so concurrent callers rarely share a
+// cache line; counters are summed when a snapshot is taken
+constexpr size_t kShardCount = 16;
+
+struct alignas(64) Shard {
+  std::atomic<uint64_t> values[kApiCount][kFieldCount];
+};
+
+Shard g_shards[kShardCount];
+
+std::atomic<size_t> g_next_shard{0};
+
+Shard &ThreadShard() {
+  thread_local Shard &shard =
+      g_shards[g_next_shard.fetch_add(1, std::memory_order_relaxed) %
+               kShardCount];
+  return shard;
+}
+
+// Allocations this thread reported through CountAllocation()
+thread_local uint64_t t_allocations = 0;
+
+#endif
+
+} // anonymous namespace
+
+#if CONMAT_ENABLE_STATS
+
+namespace detail {
+
+ApiScope::ApiScope(Api api, size_t input_bytes)
+    : api_(api), input_bytes_(input_bytes),
+      allocations_at_start_(t_allocations) {}
+
+ApiScope::~ApiScope() {
+  auto &values = ThreadShard().values[static_cast<size_t>(api_)];
+  values[Calls].fetch_add(1, std::memory_order_relaxed);
+  values[InputBytes].fetch_add(input_bytes_, std::memory_order_relaxed);
+  values[OutputBytes].fetch_add(output_bytes_, std::memory_order_relaxed);
+  values[EscapeBytes].fetch_add(escape_bytes_, std::memory_order_relaxed);
+  values[Allocations].fetch_add(t_allocations - allocations_at_start_,
+                                std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+bool Enabled() { return true; }
+
+void CountAllocation() noexcept { ++t_allocations; }
+
+Counters Snapshot() {
+  Counters counters;
+  for (const Shard &shard : g_shards) {
+    for (size_t api = 0; api < kApiCount; ++api) {
+      const auto &values = shard.values[api];
+      ApiCounters &total = counters.apis[api];
+      total.calls += values[Calls].load(std::memory_order_relaxed);
+      total.input_bytes += values[InputBytes].load(std::memory_order_relaxed);
+      total.output_bytes +=
+          values[OutputBytes].load(std::memory_order_relaxed);
+      total.escape_bytes +=
+          values[EscapeBytes].load(std::memory_order_relaxed);
+      total.allocations +=
+          values[Allocations].load(std::memory_order_relaxed);
+    }
+  }
+  return counters;
+}
+
+void Reset() {
+  for (Shard &shard : g_shards) {
+    for (auto &values : shard.values) {
+      for (auto &value : values) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+#else
+
+bool Enabled() { return false; }
+
+void CountAllocation() noexcept {}
+
+Counters Snapshot() { return {}; }
+
+void Reset() {}
+
+#endif
+
+std::string_view ApiName(Api api) {
+  size_t index = static_cast<size_t>(api);
+  return index < kApiCount ? kApiNames[index] : "Unknown";
+}
+
+std::string Report(const Counters &counters) {
+  constexpr size_t name_width = 14;
+  constexpr size_t value_width = 12;
+
+  std::string result = Header("conmat stats", 2);
+  result.push_back('\n');
+  if (!Enabled()) {
+    result.append(Indent(1));
+    result.append("disabled (configure with -DCONMAT_ENABLE_STATS=ON)\n");
+    return result;
+  }
+
+  result.append(Indent(1));
+  AppendColumn(result, "api", name_width);
+  for (std::string_view title :
+       {"calls", "in bytes", "out bytes", "esc bytes", "allocs"}) {
+    result.append(value_width - title.size(), ' ');
+    result.append(title);
+  }
+  result.push_back('\n');
+
+  for (size_t api = 0; api < kApiCount; ++api) {
+    const ApiCounters &entry = counters.apis[api];
+    if (entry.calls == 0) {
+      continue;
+    }
+    result.append(Indent(1));
+    AppendColumn(result, kApiNames[api], name_width);
+    AppendColumn(result, entry.calls, value_width);
+    AppendColumn(result, entry.input_bytes, value_width);
+    AppendColumn(result, entry.output_bytes, value_width);
+    AppendColumn(result, entry.escape_bytes, value_width);
+    AppendColumn(result, entry.allocations, value_width);
+    result.push_back('\n');
+  }
+  return result;
+}
+
+} // namespace conmat::stats
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace conmat::stats {
+
+////////////////////////////////////////////////////////////
+/// \brief Instrumented public entry points
+///
+////////////////////////////////////////////////////////////
+enum class Api {
+  FormatImpl,
+  FormatTo,
+  Divider,
+  Header,
+  Indent,
+  Sanitize,
+  SanitizeView,
+  StripAnsi,
+  AnsiStripper,
+  AnsiToHtml,
+  Wrap,
+  Tree,
+  Diff,
+  Json,
+  Gradient,
+  Chart,
+  StyledString,
+  Truncate,
+  SanitizeSgr,
+  Panel,
+  Count // Number of entries, not an API
+};
+
+/// \brief Number of instrumented entry points
+inline constexpr size_t kApiCount = static_cast<size_t>(Api::Count);
+
+////////////////////////////////////////////////////////////
+/// \brief Counters of one entry point
+///
+/// Counters are inclusive: a Header call that formats its text also
+/// counts one FormatImpl call, and both see its allocations.
+///
+////////////////////////////////////////////////////////////
+struct ApiCounters {
+  uint64_t calls = 0;
+  uint64_t input_bytes = 0;
+  uint64_t output_bytes = 0;
+  uint64_t escape_bytes = 0; // ANSI escape bytes emitted
+  uint64_t allocations = 0;  // CountAllocation() calls during the call
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Counters of every entry point at one point in time
+///
+////////////////////////////////////////////////////////////
+struct Counters {
+  ApiCounters apis[kApiCount];
+
+  ApiCounters &operator[](Api api) { return apis[static_cast<size_t>(api)]; }
+  const ApiCounters &operator[](Api api) const {
+    return apis[static_cast<size_t>(api)];
+  }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Check whether conmat was built with CONMAT_ENABLE_STATS
+///
+////////////////////////////////////////////////////////////
+bool Enabled();
+
+////////////////////////////////////////////////////////////
+/// \brief Count one allocation of the calling thread
+///
+/// conmat does not replace the global allocation functions. To fill the
+/// allocations counters, call this from your own replacement of
+/// operator new; it does nothing when stats are disabled.
+///
+/// \example
+/// void *operator new(std::size_t size) {
+///   conmat::stats::CountAllocation();
+///   ...
+/// }
+///
+////////////////////////////////////////////////////////////
+void CountAllocation() noexcept;
+
+////////////////////////////////////////////////////////////
+/// \brief Sum the per-thread counters
+///
+/// Counters are updated with relaxed atomics, so a snapshot taken while
+/// other threads format may be slightly behind. All zero when disabled.
+///
+////////////////////////////////////////////////////////////
+Counters Snapshot();
+
+////////////////////////////////////////////////////////////
+/// \brief Reset every counter to zero
+///
+////////////////////////////////////////////////////////////
+void Reset();
+
+////////////////////////////////////////////////////////////
+/// \brief Name of an entry point
+///
+////////////////////////////////////////////////////////////
+std::string_view ApiName(Api api);
+
+////////////////////////////////////////////////////////////
+/// \brief Render counters as a table with a conmat Header
+/// \param counters Counters to render (usually Snapshot())
+/// \return Multi-line report, entry points without calls are omitted
+///
+////////////////////////////////////////////////////////////
+std::string Report(const Counters &counters);
+
+} // namespace conmat::stats
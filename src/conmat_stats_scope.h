@@ -0,0 +1,50 @@
+#pragma once
+
+// Internal instrumentation hooks, only included by conmat sources. Both
+// macros compile to nothing unless CONMAT_ENABLE_STATS is set.
+
+#include "conmat_config.h"
+#include "conmat_stats.h"
+
+#if CONMAT_ENABLE_STATS
+
+namespace conmat::stats::detail {
+
+////////////////////////////////////////////////////////////
+/// \brief Records one call of an entry point when it goes out of scope
+///
+////////////////////////////////////////////////////////////
+class ApiScope {
+public:
+  ApiScope(Api api, size_t input_bytes);
+  ~ApiScope();
+
+  ApiScope(const ApiScope &) = delete;
+  ApiScope &operator=(const ApiScope &) = delete;
+
+  void Output(size_t bytes, size_t escape_bytes) {
+    output_bytes_ += bytes;
+    escape_bytes_ += escape_bytes;
+  }
+
+private:
+  Api api_;
+  size_t input_bytes_;
+  size_t output_bytes_ = 0;
+  size_t escape_bytes_ = 0;
+  uint64_t allocations_at_start_;
+};
+
+} // namespace conmat::stats::detail
+
+#define CONMAT_STATS_SCOPE(api, input_bytes)                                   \
+  ::conmat::stats::detail::ApiScope conmat_stats_scope_(api, input_bytes)
+#define CONMAT_STATS_OUTPUT(bytes, escape_bytes)                               \
+  conmat_stats_scope_.Output(bytes, escape_bytes)
+
+#else
+
+#define CONMAT_STATS_SCOPE(api, input_bytes) static_cast<void>(0)
+#define CONMAT_STATS_OUTPUT(bytes, escape_bytes) static_cast<void>(0)
+
+#endif
@@ -0,0 +1,13 @@
+#include "conmat_stream.h"
+
+namespace conmat {
+
+std::ostream &WriteFormatted(std::ostream &os, std::string_view text,
+                             const FormatOptions &options) {
+  thread_local std::string buffer;
+  buffer.clear();
+  FormatTo(buffer, text, options);
+  return os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+} // namespace conmat
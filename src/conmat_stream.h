@@ -0,0 +1,58 @@
+#pragma once
+
+// Opt-in std::ostream support. conmat.h only needs <iosfwd>; include this
+// header where formatted output goes straight to a stream.
+
+#include "conmat.h"
+#include <ostream>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Write text formatted with ANSI codes to a stream
+///
+/// Formats into a reused per-thread buffer, so warm calls do not
+/// allocate.
+///
+/// \param os The stream to write to
+/// \param text The text to format
+/// \param options Format options (default: no formatting)
+/// \return os
+///
+////////////////////////////////////////////////////////////
+std::ostream &WriteFormatted(std::ostream &os, std::string_view text,
+                             const FormatOptions &options = {});
+
+////////////////////////////////////////////////////////////
+/// \brief Stream manipulator that formats a value on output
+///
+/// Holds a reference to the value, so use it within one expression.
+///
+/// \example
+/// std::cout << Styled("error", Color::Red) << ": " << Styled(42, Style::Bold);
+///
+////////////////////////////////////////////////////////////
+template <Formattable T> class Styled {
+public:
+  Styled(const T &value, const FormatOptions &options)
+      : value_(value), options_(options) {}
+  Styled(const T &value, Color color) : value_(value), options_(color) {}
+  Styled(const T &value, Style style) : value_(value) {
+    options_.style = style;
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const Styled &styled) {
+    if constexpr (detail::StringLike<T>) {
+      return WriteFormatted(os, std::string_view(styled.value_),
+                            styled.options_);
+    } else {
+      return os << detail::FormatValue(styled.value_, styled.options_);
+    }
+  }
+
+private:
+  const T &value_;
+  FormatOptions options_;
+};
+
+} // namespace conmat
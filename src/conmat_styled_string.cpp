@@ -0,0 +1,255 @@
+#include "conmat_styled_string.h"
+#include "conmat_stats_scope.h"
+#include "conmat_text.h"
+#include <algorithm>
+#include <utility>
+
+namespace conmat {
+
+namespace {
+
+SgrColor ToSgrColor(Color color) {
+  if (color == Color::Default) {
+    return {};
+  }
+  // Black..White are palette 0-7, BrightBlack..BrightWhite 8-15
+  return {SgrColor::Kind::Indexed,
+          static_cast<uint8_t>(static_cast<int>(color) - 1)};
+}
+
+} // anonymous namespace
+
+SgrState TextStyle::ToSgrState() const {
+  SgrState state;
+  state.foreground = ToSgrColor(foreground());
+  state.background = ToSgrColor(background());
+  state.attributes = attributes();
+  return state;
+}
+
+StyledString::StyledString(std::string_view text, TextStyle style) {
+  Append(text, style);
+}
+
+StyledString::StyledString(const StyledString &other) : text_(other.text_) {
+  Reserve(other.run_count_);
+  std::copy_n(other.Runs(), other.run_count_, Runs());
+  run_count_ = other.run_count_;
+}
+
+StyledString::StyledString(StyledString &&other) noexcept
+    : text_(std::move(other.text_)), heap_(std::move(other.heap_)),
+      run_count_(other.run_count_), capacity_(other.capacity_) {
+  std::copy_n(other.inline_, kInlineRuns, inline_);
+  other.text_.clear();
+  other.run_count_ = 0;
+  other.capacity_ = kInlineRuns;
+}
+
+StyledString &StyledString::operator=(const StyledString &other) {
+  if (this != &other) {
+    text_ = other.text_;
+    run_count_ = 0;
+    Reserve(other.run_count_);
+    std::copy_n(other.Runs(), other.run_count_, Runs());
+    run_count_ = other.run_count_;
+  }
+  return *this;
+}
+
+StyledString &StyledString::operator=(StyledString &&other) noexcept {
+  if (this != &other) {
+    text_ = std::move(other.text_);
+    heap_ = std::move(other.heap_);
+    std::copy_n(other.inline_, kInlineRuns, inline_);
+    run_count_ = other.run_count_;
+    capacity_ = other.capacity_;
+    other.text_.clear();
+    other.run_count_ = 0;
+    other.capacity_ = kInlineRuns;
+  }
+  return *this;
+}
+
+StyledString &StyledString::Append(std::string_view text, TextStyle style) {
+  size_t start = text_.size();
+  detail::AppendSanitized(text_, text);
+  if (text_.size() == start) {
+    return *this;
+  }
+  if (run_count_ == 0 || Runs()[run_count_ - 1].style != style) {
+    PushRun(static_cast<uint32_t>(start), style);
+  }
+  return *this;
+}
+
+StyledString &StyledString::Append(const StyledString &other) {
+  if (&other == this) {
+    StyledString copy(other);
+    return Append(copy);
+  }
+
+  uint32_t base = static_cast<uint32_t>(text_.size());
+  text_.append(other.text_);
+  Reserve(run_count_ + other.run_count_);
+  for (size_t i = 0; i < other.run_count_; ++i) {
+    const StyleRun &run = other.Runs()[i];
+    // The first run may continue the last style of this string
+    if (i == 0 && run_count_ != 0 &&
+        Runs()[run_count_ - 1].style == run.style) {
+      continue;
+    }
+    PushRun(base + run.offset, run.style);
+  }
+  return *this;
+}
+
+StyledString StyledString::Slice(size_t offset, size_t length) const {
+  offset = std::min(offset, text_.size());
+  length = std::min(length, text_.size() - offset);
+  StyledString result;
+  result.text_.assign(text_, offset, length);
+  if (length == 0) {
+    return result;
+  }
+
+  size_t end = offset + length;
+  for (size_t i = RunIndexAt(offset); i < run_count_; ++i) {
+    const StyleRun &run = Runs()[i];
+    if (run.offset >= end) {
+      break;
+    }
+    size_t start = std::max<size_t>(run.offset, offset);
+    result.PushRun(static_cast<uint32_t>(start - offset), run.style);
+  }
+  return result;
+}
+
+void StyledString::Restyle(size_t offset, size_t length, TextStyle style) {
+  offset = std::min(offset, text_.size());
+  length = std::min(length, text_.size() - offset);
+  if (length == 0) {
+    return;
+  }
+
+  // Rebuild the run list, merging equal neighbours
+  StyledString rebuilt;
+  auto emit = [&rebuilt](size_t start, TextStyle run_style) {
+    if (rebuilt.run_count_ == 0 ||
+        rebuilt.Runs()[rebuilt.run_count_ - 1].style != run_style) {
+      rebuilt.PushRun(static_cast<uint32_t>(start), run_style);
+    }
+  };
+
+  size_t end = offset + length;
+  size_t i = 0;
+  for (; i < run_count_ && Runs()[i].offset < offset; ++i) {
+    emit(Runs()[i].offset, Runs()[i].style);
+  }
+  emit(offset, style);
+  if (end < text_.size()) {
+    size_t after = RunIndexAt(end);
+    emit(end, Runs()[after].style);
+    for (i = after + 1; i < run_count_; ++i) {
+      emit(Runs()[i].offset, Runs()[i].style);
+    }
+  }
+
+  rebuilt.text_ = std::move(text_);
+  *this = std::move(rebuilt);
+}
+
+TextStyle StyledString::StyleAt(size_t offset) const {
+  if (offset >= text_.size()) {
+    return {};
+  }
+  return Runs()[RunIndexAt(offset)].style;
+}
+
+size_t StyledString::DisplayWidth() const {
+  return conmat::DisplayWidth(text_);
+}
+
+void StyledString::RenderTo(std::string &out) const {
+  CONMAT_STATS_SCOPE(stats::Api::StyledString, text_.size());
+  [[maybe_unused]] size_t start = out.size();
+  [[maybe_unused]] size_t escape_bytes = 0;
+  constexpr std::string_view kReset = "\033[0m";
+
+  bool styled = false;
+  for (size_t i = 0; i < run_count_; ++i) {
+    const StyleRun &run = Runs()[i];
+    size_t end = i + 1 < run_count_ ? Runs()[i + 1].offset : text_.size();
+    size_t before = out.size();
+    if (!run.style.IsDefault()) {
+      run.style.ToSgrState().AppendTo(out);
+      if (styled) {
+        // One sequence clears the previous style and sets the next
+        out.insert(before + 2, "0;");
+      }
+      styled = true;
+    } else if (styled) {
+      out.append(kReset);
+      styled = false;
+    }
+    escape_bytes += out.size() - before;
+    out.append(text_, run.offset, end - run.offset);
+  }
+  if (styled) {
+    out.append(kReset);
+    escape_bytes += kReset.size();
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, escape_bytes);
+}
+
+std::string StyledString::Render() const {
+  std::string result;
+  result.reserve(text_.size() + run_count_ * 8 + 4);
+  RenderTo(result);
+  return result;
+}
+
+void StyledString::clear() {
+  text_.clear();
+  run_count_ = 0;
+}
+
+bool StyledString::operator==(const StyledString &other) const {
+  return text_ == other.text_ && run_count_ == other.run_count_ &&
+         std::equal(Runs(), Runs() + run_count_, other.Runs(),
+                    [](const StyleRun &a, const StyleRun &b) {
+                      return a.offset == b.offset && a.style == b.style;
+                    });
+}
+
+void StyledString::PushRun(uint32_t offset, TextStyle style) {
+  if (run_count_ == capacity_) {
+    Reserve(capacity_ * 2);
+  }
+  Runs()[run_count_++] = {offset, style};
+}
+
+void StyledString::Reserve(uint32_t capacity) {
+  if (capacity <= capacity_) {
+    return;
+  }
+  std::unique_ptr<StyleRun[]> runs(new StyleRun[capacity]);
+  std::copy_n(Runs(), run_count_, runs.get());
+  heap_ = std::move(runs);
+  capacity_ = capacity;
+}
+
+size_t StyledString::RunIndexAt(size_t offset) const {
+  const StyleRun *begin = Runs();
+  const StyleRun *run = std::upper_bound(
+      begin + 1, begin + run_count_, offset,
+      [](size_t value, const StyleRun &r) { return value < r.offset; });
+  return static_cast<size_t>(run - begin) - 1;
+}
+
+StyledString operator+(StyledString left, const StyledString &right) {
+  left.Append(right);
+  return left;
+}
+
+} // namespace conmat
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "conmat.h"
+#include "conmat_ansi.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Style of a run of text, packed into 32 bits
+///
+/// Holds a foreground and background Color and a set of sgr_attribute
+/// bits, so several styles can be combined.
+///
+////////////////////////////////////////////////////////////
+class TextStyle {
+public:
+  constexpr TextStyle() = default;
+  constexpr TextStyle(Color fg) : TextStyle(fg, Color::Default) {}
+  constexpr TextStyle(Style s)
+      : TextStyle(Color::Default, Color::Default, s) {}
+  constexpr TextStyle(Color fg, Style s) : TextStyle(fg, Color::Default, s) {}
+  constexpr TextStyle(Color fg, Color bg, Style s = Style::Default)
+      : bits_(static_cast<uint32_t>(fg) | static_cast<uint32_t>(bg) << 8 |
+              AttributeBit(s) << 16) {}
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Pack the colors and style of FormatOptions
+  ///
+  /// reset_after is ignored: a StyledString resets once, at the end.
+  ///
+  ////////////////////////////////////////////////////////////
+  constexpr TextStyle(const FormatOptions &options)
+      : TextStyle(options.foreground, options.background, options.style) {}
+
+  constexpr Color foreground() const { return Color(bits_ & 0xFF); }
+  constexpr Color background() const { return Color((bits_ >> 8) & 0xFF); }
+  constexpr uint16_t attributes() const {
+    return static_cast<uint16_t>(bits_ >> 16);
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Add a style to the attribute set
+  ///
+  ////////////////////////////////////////////////////////////
+  constexpr TextStyle With(Style style) const {
+    TextStyle result = *this;
+    result.bits_ |= AttributeBit(style) << 16;
+    return result;
+  }
+
+  constexpr bool IsDefault() const { return bits_ == 0; }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Equivalent SGR state, for rendering
+  ///
+  ////////////////////////////////////////////////////////////
+  SgrState ToSgrState() const;
+
+  constexpr bool operator==(const TextStyle &) const = default;
+
+private:
+  static constexpr uint32_t AttributeBit(Style style) {
+    return style == Style::Default ? 0u
+                                   : 1u << (static_cast<int>(style) - 1);
+  }
+
+  uint32_t bits_ = 0;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Style of the text from offset up to the next run
+///
+////////////////////////////////////////////////////////////
+struct StyleRun {
+  uint32_t offset = 0; // Byte offset into StyledString::text()
+  TextStyle style;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Text with style runs, rendered to escape codes on output
+///
+/// Stores plain, sanitized text plus a run-length list of styles, so
+/// styled pieces can be concatenated, sliced, measured and restyled
+/// without parsing or stripping escape sequences. Escape codes are
+/// generated once, by Render(), with one sequence per style change and
+/// a single reset at the end.
+///
+/// Appending text in the style of the last run only extends the text;
+/// a new style adds one 8-byte run. The first runs are stored inline
+/// and short text fits std::string's inline buffer, so small strings do
+/// not allocate for their styles.
+///
+/// Offsets and lengths are in bytes; slicing inside a UTF-8 character
+/// splits it.
+///
+/// \example
+/// StyledString line("error", {Color::Red, Style::Bold});
+/// line.Append(": ").Append("file.txt", Color::Cyan);
+/// size_t width = line.DisplayWidth();   // 15, no escapes counted
+/// std::string out = line.Render();      // escapes written only here
+///
+////////////////////////////////////////////////////////////
+class StyledString {
+public:
+  static constexpr size_t npos = std::string_view::npos;
+
+  StyledString() = default;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a string with one style
+  /// \param text Text, control characters are removed
+  /// \param style Style of the whole text
+  ///
+  ////////////////////////////////////////////////////////////
+  StyledString(std::string_view text, TextStyle style = {});
+
+  StyledString(const StyledString &other);
+  StyledString(StyledString &&other) noexcept;
+  StyledString &operator=(const StyledString &other);
+  StyledString &operator=(StyledString &&other) noexcept;
+  ~StyledString() = default;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append text in a style
+  /// \param text Text, control characters are removed
+  /// \param style Style of the appended text
+  /// \return *this
+  ///
+  ////////////////////////////////////////////////////////////
+  StyledString &Append(std::string_view text, TextStyle style = {});
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append another styled string, keeping its styles
+  /// \return *this
+  ///
+  ////////////////////////////////////////////////////////////
+  StyledString &Append(const StyledString &other);
+
+  StyledString &operator+=(const StyledString &other) {
+    return Append(other);
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Copy a range of the string with its styles
+  /// \param offset First byte, clamped to size()
+  /// \param length Number of bytes, clamped to the end
+  /// \return The slice
+  ///
+  ////////////////////////////////////////////////////////////
+  StyledString Slice(size_t offset, size_t length = npos) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Change the style of a range
+  /// \param offset First byte, clamped to size()
+  /// \param length Number of bytes, clamped to the end
+  /// \param style New style of the range
+  ///
+  ////////////////////////////////////////////////////////////
+  void Restyle(size_t offset, size_t length, TextStyle style);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Style of the byte at offset
+  ///
+  ////////////////////////////////////////////////////////////
+  TextStyle StyleAt(size_t offset) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Number of terminal columns of the text
+  ///
+  ////////////////////////////////////////////////////////////
+  size_t DisplayWidth() const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append the text with escape codes
+  /// \param out String the rendered text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void RenderTo(std::string &out) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Render the text with escape codes
+  /// \return The rendered string
+  ///
+  ////////////////////////////////////////////////////////////
+  std::string Render() const;
+
+  std::string_view text() const { return text_; }
+  size_t size() const { return text_.size(); }
+  bool empty() const { return text_.empty(); }
+  size_t run_count() const { return run_count_; }
+  const StyleRun &run(size_t index) const { return Runs()[index]; }
+
+  void clear();
+
+  bool operator==(const StyledString &other) const;
+
+private:
+  static constexpr uint32_t kInlineRuns = 2;
+
+  StyleRun *Runs() { return heap_ ? heap_.get() : inline_; }
+  const StyleRun *Runs() const { return heap_ ? heap_.get() : inline_; }
+  void PushRun(uint32_t offset, TextStyle style);
+  void Reserve(uint32_t capacity);
+  size_t RunIndexAt(size_t offset) const;
+
+  std::string text_;
+  StyleRun inline_[kInlineRuns];
+  std::unique_ptr<StyleRun[]> heap_; // Runs when more than kInlineRuns
+  uint32_t run_count_ = 0;
+  uint32_t capacity_ = kInlineRuns;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Concatenate two styled strings
+///
+////////////////////////////////////////////////////////////
+StyledString operator+(StyledString left, const StyledString &right);
+
+} // namespace conmat
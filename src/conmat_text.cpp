@@ -0,0 +1,476 @@
+#include "conmat_text.h"
+#include "conmat.h"
+#include "conmat_stats_scope.h"
+#include <algorithm>
+
+namespace conmat {
+
+namespace {
+
+constexpr char32_t kReplacementCharacter = 0xFFFD;
+
+struct CodepointRange {
+  char32_t first;
+  char32_t last;
+};
+
+// Combining marks and format characters that take no column (sorted)
+constexpr CodepointRange kZeroWidth[] = {
+    {0x0300, 0x036F},   {0x0483, 0x0489},   {0x0591, 0x05BD},
+    {0x0610, 0x061A},   {0x064B, 0x065F},   {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A},   {0x0E47, 0x0E4E},   {0x1AB0, 0x1AFF},
+    {0x1DC0, 0x1DFF},   {0x200B, 0x200F},   {0x202A, 0x202E},
+    {0x2060, 0x2064},   {0x20D0, 0x20FF},   {0xFE00, 0xFE0F},
+    {0xFE20, 0xFE2F},   {0xFEFF, 0xFEFF},   {0x1F3FB, 0x1F3FF},
+    {0xE0001, 0xE007F}, {0xE0100, 0xE01EF}};
+
+// East Asian wide and fullwidth characters and emoji (sorted)
+constexpr CodepointRange kDoubleWidth[] = {
+    {0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},
+    {0x23E9, 0x23EC},   {0x23F0, 0x23F0},   {0x23F3, 0x23F3},
+    {0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},
+    {0x267F, 0x267F},   {0x2693, 0x2693},   {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},
+    {0x26F2, 0x26F3},   {0x26F5, 0x26F5},   {0x26FA, 0x26FA},
+    {0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},
+    {0x2728, 0x2728},   {0x274C, 0x274C},   {0x274E, 0x274E},
+    {0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+    {0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x2E80, 0x303E},
+    {0x3041, 0x33FF},   {0x3400, 0x4DBF},   {0x4E00, 0x9FFF},
+    {0xA000, 0xA4CF},   {0xA960, 0xA97F},   {0xAC00, 0xD7A3},
+    {0xF900, 0xFAFF},   {0xFE10, 0xFE19},   {0xFE30, 0xFE6F},
+    {0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},   {0x16FE0, 0x16FE4},
+    {0x17000, 0x18AFF}, {0x1B000, 0x1B2FF}, {0x1F004, 0x1F004},
+    {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F251}, {0x1F300, 0x1F3FA}, {0x1F400, 0x1F64F},
+    {0x1F680, 0x1F6FF}, {0x1F7E0, 0x1F7EB}, {0x1F90C, 0x1F9FF},
+    {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD}, {0x30000, 0x3FFFD}};
+
+template <size_t N>
+bool InRanges(const CodepointRange (&ranges)[N], char32_t codepoint) {
+  const CodepointRange *range = std::upper_bound(
+      ranges, ranges + N, codepoint,
+      [](char32_t value, const CodepointRange &r) { return value < r.first; });
+  return range != ranges && codepoint <= (range - 1)->last;
+}
+
+size_t TextWidth(std::string_view text) {
+  size_t width = 0;
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos < end) {
+    // ASCII runs need no decoding
+    if (static_cast<unsigned char>(*pos) < 0x80) {
+      width += (*pos >= 0x20 && *pos != 0x7F) ? 1 : 0;
+      ++pos;
+      continue;
+    }
+    width += detail::CodepointWidth(detail::DecodeUtf8(pos, end));
+  }
+  return width;
+}
+
+} // anonymous namespace
+
+namespace detail {
+
+size_t CodepointWidth(char32_t codepoint) {
+  if (codepoint < 0x20 || (codepoint >= 0x7F && codepoint < 0xA0)) {
+    return 0;
+  }
+  if (codepoint < 0x300) {
+    return 1;
+  }
+  if (InRanges(kZeroWidth, codepoint)) {
+    return 0;
+  }
+  return InRanges(kDoubleWidth, codepoint) ? 2 : 1;
+}
+
+char32_t DecodeUtf8(const char *&pos, const char *end) {
+  unsigned char lead = static_cast<unsigned char>(*pos++);
+  if (lead < 0x80) {
+    return lead;
+  }
+
+  size_t extra;
+  char32_t codepoint;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    extra = 1;
+    codepoint = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    extra = 2;
+    codepoint = lead & 0x0F;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    extra = 3;
+    codepoint = lead & 0x07;
+  } else {
+    return kReplacementCharacter;
+  }
+
+  if (static_cast<size_t>(end - pos) < extra) {
+    return kReplacementCharacter;
+  }
+  for (size_t i = 0; i < extra; ++i) {
+    unsigned char c = static_cast<unsigned char>(pos[i]);
+    if ((c & 0xC0) != 0x80) {
+      return kReplacementCharacter;
+    }
+    codepoint = (codepoint << 6) | (c & 0x3F);
+  }
+  pos += extra;
+  return codepoint;
+}
+
+} // namespace detail
+
+size_t DisplayWidth(std::string_view text) {
+  size_t width = 0;
+  for (const AnsiToken &token : AnsiTokenizer(text)) {
+    if (token.kind == AnsiTokenKind::Text) {
+      width += TextWidth(token.text);
+    }
+  }
+  return width;
+}
+
+// Parser handler forwarding text and SGR sequences to the wrapper
+struct WrapHandler {
+  WordWrapper &wrapper;
+  std::string &out;
+
+  void OnText(std::string_view text) { wrapper.AppendText(text, out); }
+
+  void OnSequence(const AnsiSequence &sequence) {
+    if (sequence.type == AnsiSequenceType::Sgr) {
+      wrapper.AppendSgr(sequence.parameters);
+    }
+  }
+};
+
+WordWrapper::WordWrapper(size_t width, size_t indent, size_t spaces_per_level)
+    : width_(std::max<size_t>(width, 1)),
+      indent_(Indent(indent, spaces_per_level)) {
+  // Wrapped lines keep at least one column for text
+  if (indent_.size() >= width_) {
+    indent_.resize(width_ - 1);
+  }
+}
+
+void WordWrapper::Feed(std::string_view chunk, std::string &out) {
+  CONMAT_STATS_SCOPE(stats::Api::Wrap, chunk.size());
+  [[maybe_unused]] size_t start = out.size();
+  WrapHandler handler{*this, out};
+  parser_.Feed(chunk, handler);
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+void WordWrapper::Finish(std::string &out) {
+  CommitWord(out);
+  parser_.Reset();
+  output_state_ = SgrState{};
+  input_state_ = SgrState{};
+  column_ = 0;
+  line_start_ = 0;
+  pending_spaces_ = 0;
+  line_empty_ = true;
+}
+
+void WordWrapper::AppendText(std::string_view text, std::string &out) {
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+  while (pos < end) {
+    const char *run = pos;
+    while (pos < end && *pos != ' ' &&
+           static_cast<unsigned char>(*pos) >= 0x20 && *pos != 0x7F) {
+      ++pos;
+    }
+    word_.append(run, pos);
+    word_width_ += DisplayWidth(std::string_view(run, pos));
+    FlushLongWord(out);
+    if (pos == end) {
+      break;
+    }
+    if (*pos == ' ' || *pos == '\t') {
+      CommitWord(out);
+      ++pending_spaces_;
+    } else if (*pos == '\n') {
+      CommitWord(out);
+      BreakLine(out, false);
+    }
+    // Carriage returns and other control bytes are dropped
+    ++pos;
+  }
+}
+
+void WordWrapper::AppendSgr(std::string_view parameters) {
+  word_.append("\033[");
+  word_.append(parameters);
+  word_.push_back('m');
+  input_state_.Apply(parameters);
+}
+
+void WordWrapper::FlushLongWord(std::string &out) {
+  // Once the word cannot fit even after a line break it will be split
+  // whatever follows, so place it now instead of buffering all of it
+  if (splitting_) {
+    CommitWord(out);
+    splitting_ = true;
+    return;
+  }
+  bool breaks = column_ + pending_spaces_ + word_width_ > width_;
+  size_t start = !breaks      ? column_ + pending_spaces_
+                 : line_empty_ ? column_
+                               : indent_.size();
+  if (start + word_width_ > width_) {
+    CommitWord(out);
+    splitting_ = true;
+  }
+}
+
+void WordWrapper::CommitWord(std::string &out) {
+  if (splitting_) {
+    // Rest of a word that is already being split
+    SplitWord(out);
+    line_empty_ = false;
+    word_.clear();
+    word_width_ = 0;
+    splitting_ = false;
+    return;
+  }
+  if (word_.empty()) {
+    return;
+  }
+
+  size_t word_width = word_width_;
+  if (word_width == 0) {
+    // Only style changes: keep the spaces pending for the next word
+    out.append(word_);
+    output_state_ = input_state_;
+    word_.clear();
+    return;
+  }
+
+  if (column_ + pending_spaces_ + word_width > width_) {
+    if (!line_empty_) {
+      BreakLine(out, true);
+    }
+    // Leading spaces that do not fit on a line are dropped
+    pending_spaces_ = 0;
+  }
+  out.append(pending_spaces_, ' ');
+  column_ += pending_spaces_;
+  pending_spaces_ = 0;
+
+  if (column_ + word_width <= width_) {
+    out.append(word_);
+    column_ += word_width;
+    output_state_ = input_state_;
+  } else {
+    SplitWord(out);
+  }
+  line_empty_ = false;
+  word_.clear();
+  word_width_ = 0;
+}
+
+void WordWrapper::SplitWord(std::string &out) {
+  // Place the word character by character, breaking where a line fills
+  for (const AnsiToken &token : AnsiTokenizer(word_)) {
+    if (token.kind == AnsiTokenKind::Sgr) {
+      out.append(token.text);
+      output_state_.Apply(token.parameters);
+      continue;
+    }
+    const char *pos = token.text.data();
+    const char *end = pos + token.text.size();
+    while (pos < end) {
+      const char *character = pos;
+      size_t character_width =
+          detail::CodepointWidth(detail::DecodeUtf8(pos, end));
+      if (column_ + character_width > width_ && column_ > line_start_) {
+        BreakLine(out, true);
+      }
+      out.append(character, pos);
+      column_ += character_width;
+    }
+  }
+}
+
+void WordWrapper::BreakLine(std::string &out, bool wrapped) {
+  bool styled = !output_state_.IsDefault();
+  if (styled) {
+    out.append("\033[0m");
+  }
+  out.push_back('\n');
+  if (wrapped) {
+    out.append(indent_);
+  }
+  if (styled) {
+    output_state_.AppendTo(out);
+  }
+  column_ = wrapped ? indent_.size() : 0;
+  line_start_ = column_;
+  pending_spaces_ = 0;
+  line_empty_ = true;
+}
+
+std::string Wrap(std::string_view text, size_t width, size_t indent) {
+  std::string result;
+  result.reserve(text.size() + text.size() / 8);
+  WordWrapper wrapper(width, indent);
+  wrapper.Feed(text, result);
+  wrapper.Finish(result);
+  return result;
+}
+
+namespace {
+
+constexpr std::string_view kReset = "\033[0m";
+
+// Width of the character at pos, advancing past it
+size_t NextCharacterWidth(const char *&pos, const char *end) {
+  unsigned char byte = static_cast<unsigned char>(*pos);
+  if (byte < 0x80) {
+    ++pos;
+    return byte >= 0x20 && byte != 0x7F ? 1 : 0;
+  }
+  return detail::CodepointWidth(detail::DecodeUtf8(pos, end));
+}
+
+// Copy text while it fits in max_width columns. If it does not, keep
+// only what fits in limit columns, close an open style and return true.
+bool AppendHead(std::string &out, std::string_view text, size_t limit,
+                size_t max_width) {
+  SgrState state;
+  size_t width = 0;
+  size_t cut = std::string::npos; // Output size at the limit
+  bool styled_at_cut = false;
+
+  for (const AnsiToken &token : AnsiTokenizer(text)) {
+    if (token.is_escape()) {
+      if (token.kind == AnsiTokenKind::Sgr) {
+        state.Apply(token.parameters);
+      }
+      out.append(token.text);
+      continue;
+    }
+
+    const char *begin = token.text.data();
+    const char *end = begin + token.text.size();
+    const char *pos = begin;
+    while (pos < end) {
+      const char *character = pos;
+      size_t character_width = NextCharacterWidth(pos, end);
+      if (cut == std::string::npos && width + character_width > limit) {
+        cut = out.size() + static_cast<size_t>(character - begin);
+        styled_at_cut = !state.IsDefault();
+      }
+      if (width + character_width > max_width) {
+        // Shrink back to the limit; nothing past it was appended yet
+        if (cut > out.size()) {
+          out.append(begin, cut - out.size());
+        } else {
+          out.resize(cut);
+        }
+        if (styled_at_cut) {
+          out.append(kReset);
+        }
+        return true;
+      }
+      width += character_width;
+    }
+    out.append(token.text);
+  }
+  return false;
+}
+
+// Append the text after its first skip columns. Style changes in the
+// skipped part are folded into one sequence; other escapes there are
+// dropped.
+void AppendTail(std::string &out, std::string_view text, size_t skip) {
+  SgrState state;
+  size_t skipped = 0;
+  bool skipping = true;
+
+  for (const AnsiToken &token : AnsiTokenizer(text)) {
+    if (!skipping) {
+      out.append(token.text);
+      continue;
+    }
+    if (token.is_escape()) {
+      if (token.kind == AnsiTokenKind::Sgr) {
+        state.Apply(token.parameters);
+      }
+      continue;
+    }
+
+    const char *pos = token.text.data();
+    const char *end = pos + token.text.size();
+    while (pos < end) {
+      const char *character = pos;
+      size_t character_width = NextCharacterWidth(pos, end);
+      // Zero-width characters stay with the character before them
+      if (skipped >= skip && character_width != 0) {
+        pos = character;
+        skipping = false;
+        break;
+      }
+      skipped += character_width;
+    }
+    if (!skipping) {
+      state.AppendTo(out);
+      out.append(pos, end);
+    }
+  }
+}
+
+} // anonymous namespace
+
+void TruncateTo(std::string &out, std::string_view text, size_t max_width,
+                std::string_view ellipsis, TruncateMode mode) {
+  CONMAT_STATS_SCOPE(stats::Api::Truncate, text.size());
+  [[maybe_unused]] size_t start = out.size();
+
+  size_t ellipsis_width = DisplayWidth(ellipsis);
+  if (ellipsis_width > max_width) {
+    ellipsis = {};
+    ellipsis_width = 0;
+  }
+  size_t available = max_width - ellipsis_width;
+
+  if (mode == TruncateMode::End) {
+    if (AppendHead(out, text, available, max_width)) {
+      out.append(ellipsis);
+    }
+    CONMAT_STATS_OUTPUT(out.size() - start, 0);
+    return;
+  }
+
+  size_t width = DisplayWidth(text);
+  if (width <= max_width) {
+    out.append(text);
+  } else if (mode == TruncateMode::Start) {
+    out.append(ellipsis);
+    AppendTail(out, text, width - available);
+  } else {
+    size_t head = available - available / 2;
+    AppendHead(out, text, head, head);
+    out.append(ellipsis);
+    AppendTail(out, text, width - available / 2);
+  }
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+}
+
+std::string Truncate(std::string_view text, size_t max_width,
+                     std::string_view ellipsis, TruncateMode mode) {
+  // The result never exceeds the input plus the ellipsis and a reset
+  std::string result;
+  result.reserve(text.size() + ellipsis.size() + kReset.size());
+  TruncateTo(result, text, max_width, ellipsis, mode);
+  return result;
+}
+
+} // namespace conmat
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "conmat_ansi.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace conmat {
+
+namespace detail {
+
+////////////////////////////////////////////////////////////
+/// \brief Decode one UTF-8 character and advance past it
+///
+/// Invalid or truncated sequences decode as U+FFFD and consume a single
+/// byte, so the loop `while (pos < end) DecodeUtf8(pos, end);` always
+/// terminates.
+///
+////////////////////////////////////////////////////////////
+char32_t DecodeUtf8(const char *&pos, const char *end);
+
+////////////////////////////////////////////////////////////
+/// \brief Number of terminal columns of one character (0, 1 or 2)
+///
+////////////////////////////////////////////////////////////
+size_t CodepointWidth(char32_t codepoint);
+
+} // namespace detail
+
+////////////////////////////////////////////////////////////
+/// \brief Number of terminal columns text occupies
+///
+/// Escape sequences take no space. UTF-8 is decoded: East Asian wide
+/// characters and emoji count as two columns, combining marks and
+/// control characters as zero. Invalid bytes count as one column each.
+///
+/// \param text Text that may contain escape sequences
+/// \return Display width in columns
+///
+/// \example
+/// DisplayWidth(Colorize("ok", Color::Green));  // 2
+/// DisplayWidth("日本");                          // 4
+///
+////////////////////////////////////////////////////////////
+size_t DisplayWidth(std::string_view text);
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming escape-aware word wrapper
+///
+/// Breaks text at spaces so that no line is wider than the given width,
+/// measuring with DisplayWidth(). Words wider than a line are split
+/// between characters. Lines produced by wrapping start with a hanging
+/// indent built from Indent(indent).
+///
+/// SGR sequences are kept; at every line break the active style is
+/// closed with a reset and reopened on the next line, so each output
+/// line renders correctly on its own. Other escape sequences, carriage
+/// returns and control characters are dropped. Tabs are treated as a
+/// single space and whitespace at a line break is dropped.
+///
+/// Each Feed() appends complete output as it goes; only the current word
+/// is buffered, so memory use does not depend on the input size.
+///
+/// \example
+/// WordWrapper wrapper(10);
+/// std::string out;
+/// wrapper.Feed("the quick brown fox", out);
+/// wrapper.Finish(out);  // "the quick\nbrown fox"
+///
+////////////////////////////////////////////////////////////
+class WordWrapper {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a wrapper
+  /// \param width Maximum line width in columns (at least 1)
+  /// \param indent Indentation level of wrapped lines, limited so that
+  ///        wrapped lines keep at least one column for text
+  /// \param spaces_per_level Number of spaces per indentation level
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit WordWrapper(size_t width, size_t indent = 0,
+                       size_t spaces_per_level = 2);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Wrap the next chunk of input
+  /// \param chunk Text to wrap, words and sequences may span chunks
+  /// \param out String the wrapped text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Feed(std::string_view chunk, std::string &out);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Flush the last word and reset the wrapper
+  /// \param out String the remaining text is appended to
+  ///
+  ////////////////////////////////////////////////////////////
+  void Finish(std::string &out);
+
+private:
+  friend struct WrapHandler;
+
+  void AppendText(std::string_view text, std::string &out);
+  void AppendSgr(std::string_view parameters);
+  void FlushLongWord(std::string &out);
+  void CommitWord(std::string &out);
+  void SplitWord(std::string &out);
+  void BreakLine(std::string &out, bool wrapped);
+
+  AnsiStreamParser parser_;
+  size_t width_;
+  std::string indent_;
+  std::string word_;       // Pending word, including its SGR sequences
+  size_t word_width_ = 0;  // Columns of the text in word_
+  SgrState output_state_;  // Style at the end of the emitted text
+  SgrState input_state_;   // Style at the end of the parsed input
+  size_t column_ = 0;
+  size_t line_start_ = 0;  // Column of the first character of the line
+  size_t pending_spaces_ = 0;
+  bool line_empty_ = true; // No word placed on the current line yet
+  bool splitting_ = false; // word_ continues a word already being split
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Word wrap a complete string
+/// \param text Text that may contain SGR sequences
+/// \param width Maximum line width in columns
+/// \param indent Indentation level of wrapped lines (default: 0)
+/// \return Wrapped text
+///
+/// \example
+/// Wrap("aaa bbb ccc", 7, 1);  // "aaa bbb\n  ccc"
+///
+////////////////////////////////////////////////////////////
+std::string Wrap(std::string_view text, size_t width, size_t indent = 0);
+
+////////////////////////////////////////////////////////////
+/// \brief Part of the text that Truncate() replaces with the ellipsis
+///
+////////////////////////////////////////////////////////////
+enum class TruncateMode : uint8_t {
+  End,    // "long text…"
+  Middle, // "long…text"
+  Start   // "…text"
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Append text shortened to a display width
+///
+/// Text that fits in max_width columns is appended unchanged. Otherwise
+/// characters are removed so that the rest plus the ellipsis fit. The
+/// ellipsis is left out if it is wider than max_width. Widths are
+/// measured as by DisplayWidth().
+///
+/// Escape sequences before the cut are kept. If the cut falls inside a
+/// styled run, the style is closed with a reset before the ellipsis.
+/// For Start and Middle, the kept tail reopens the style that is active
+/// where it begins, so the ellipsis itself is never styled.
+///
+/// End mode takes a single pass over the text. Start and Middle
+/// measure the text first. Nothing is allocated besides the growth of
+/// out.
+///
+/// \param out String the result is appended to
+/// \param text Text that may contain escape sequences
+/// \param max_width Maximum width of the result in columns
+/// \param ellipsis Marker for the removed part
+/// \param mode Part of the text to remove
+///
+////////////////////////////////////////////////////////////
+void TruncateTo(std::string &out, std::string_view text, size_t max_width,
+                std::string_view ellipsis = "…",
+                TruncateMode mode = TruncateMode::End);
+
+////////////////////////////////////////////////////////////
+/// \brief Shorten text to a display width
+/// \return The text, or its shortened form with the ellipsis
+///
+/// \example
+/// Truncate(Colorize("conmat_theme.cpp", Color::Cyan), 10);
+/// // "\033[36mconmat_th\033[0m…"
+/// Truncate("/usr/local/include", 12, "...", TruncateMode::Middle);
+/// // "/usr/...lude"
+///
+////////////////////////////////////////////////////////////
+std::string Truncate(std::string_view text, size_t max_width,
+                     std::string_view ellipsis = "…",
+                     TruncateMode mode = TruncateMode::End);
+
+} // namespace conmat
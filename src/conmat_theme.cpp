@@ -0,0 +1,213 @@
+#include "conmat_theme.h"
+#include <thread>
+
+namespace conmat {
+
+namespace {
+
+// Threads are spread over shards so concurrent formatting calls rarely
+// share a cache line
+constexpr size_t kReaderShards = 16;
+
+size_t ReaderShard() {
+  static std::atomic<size_t> next{0};
+  thread_local size_t shard =
+      next.fetch_add(1, std::memory_order_relaxed) % kReaderShards;
+  return shard;
+}
+
+} // anonymous namespace
+
+// Immutable escape codes of every handle, indexed by handle
+struct ThemeRegistry::Table {
+  std::vector<FormatOptions> options;
+  std::string storage; // Backing bytes of every view in codes
+  std::vector<StyleCodes> codes;
+};
+
+// Formatting calls in progress, counted per epoch parity. A swap moves
+// the epoch on and waits for the calls counted under the old parity;
+// later calls can only load the new table.
+struct ThemeRegistry::Readers {
+  struct alignas(64) Shard {
+    std::atomic<uint32_t> counts[2] = {0, 0};
+  };
+
+  std::atomic<uint32_t> epoch{0};
+  Shard shards[kReaderShards];
+
+  // Start the next epoch and wait for every call counted under the
+  // current one. Calls are serialized by retire_mutex_, so every earlier
+  // epoch has already drained.
+  void Synchronize() {
+    uint32_t parity = epoch.load(std::memory_order_relaxed) & 1;
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    for (Shard &shard : shards) {
+      while (shard.counts[parity].load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+ThemeRegistry::View::View(const ThemeRegistry &registry) {
+  Readers &readers = *registry.readers_;
+  Readers::Shard &shard = readers.shards[ReaderShard()];
+  // Count the reader under the epoch it observes; if a swap moved the
+  // epoch on meanwhile, count it again under the new one
+  for (;;) {
+    uint32_t epoch = readers.epoch.load(std::memory_order_seq_cst);
+    count_ = &shard.counts[epoch & 1];
+    count_->fetch_add(1, std::memory_order_seq_cst);
+    if (readers.epoch.load(std::memory_order_seq_cst) == epoch) {
+      break;
+    }
+    count_->fetch_sub(1, std::memory_order_release);
+  }
+  table_ = registry.active_.load(std::memory_order_seq_cst);
+}
+
+ThemeRegistry::View::~View() {
+  count_->fetch_sub(1, std::memory_order_release);
+}
+
+StyleCodes ThemeRegistry::View::Codes(StyleHandle handle) const {
+  if (handle.index() >= table_->codes.size()) {
+    return {};
+  }
+  return table_->codes[handle.index()];
+}
+
+ThemeRegistry::ThemeRegistry() : readers_(std::make_unique<Readers>()) {
+  Publish({});
+}
+
+ThemeRegistry::~ThemeRegistry() = default;
+
+StyleHandle ThemeRegistry::Register(std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = handles_.find(name);
+  if (it == handles_.end()) {
+    it = handles_
+             .emplace(std::string(name), static_cast<uint32_t>(handles_.size()))
+             .first;
+  }
+  return StyleHandle(it->second);
+}
+
+StyleHandle ThemeRegistry::Find(std::string_view name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = handles_.find(name);
+  return it == handles_.end() ? StyleHandle() : StyleHandle(it->second);
+}
+
+void ThemeRegistry::Load(const std::vector<ThemeEntry> &entries) {
+  std::vector<StyleHandle> handles;
+  handles.reserve(entries.size());
+  for (const ThemeEntry &entry : entries) {
+    handles.push_back(Register(entry.name));
+  }
+
+  std::unique_ptr<const Table> replaced;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FormatOptions plain;
+    plain.reset_after = false;
+    std::vector<FormatOptions> options(handles_.size(), plain);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      options[handles[i].index()] = entries[i].options;
+    }
+    replaced = Publish(std::move(options));
+  }
+  Retire(std::move(replaced));
+}
+
+void ThemeRegistry::Set(std::string_view name, const FormatOptions &options) {
+  StyleHandle handle = Register(name);
+
+  std::unique_ptr<const Table> replaced;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<FormatOptions> table_options = table_->options;
+    FormatOptions plain;
+    plain.reset_after = false;
+    table_options.resize(handles_.size(), plain);
+    table_options[handle.index()] = options;
+    replaced = Publish(std::move(table_options));
+  }
+  Retire(std::move(replaced));
+}
+
+ThemeRegistry::View ThemeRegistry::Active() const { return View(*this); }
+
+void ThemeRegistry::FormatTo(std::string &out, StyleHandle handle,
+                             std::string_view text) const {
+  View theme(*this);
+  StyleCodes codes = theme.Codes(handle);
+  out.append(codes.prefix);
+  detail::AppendSanitized(out, text);
+  out.append(codes.suffix);
+}
+
+std::string ThemeRegistry::Format(StyleHandle handle,
+                                  std::string_view text) const {
+  View theme(*this);
+  StyleCodes codes = theme.Codes(handle);
+  std::string result;
+  result.reserve(codes.prefix.size() + text.size() + codes.suffix.size());
+  result.append(codes.prefix);
+  detail::AppendSanitized(result, text);
+  result.append(codes.suffix);
+  return result;
+}
+
+// Called with mutex_ held (or from the constructor); returns the
+// replaced table, which readers may still be using
+std::unique_ptr<const ThemeRegistry::Table>
+ThemeRegistry::Publish(std::vector<FormatOptions> options) {
+  auto table = std::make_unique<Table>();
+  table->options = std::move(options);
+
+  // Render every prefix and suffix first, then point the views into the
+  // finished storage
+  std::vector<size_t> offsets;
+  offsets.reserve(table->options.size() * 2 + 1);
+  FormatOptions reset;
+  for (const FormatOptions &style : table->options) {
+    FormatOptions codes = style;
+    codes.reset_after = false;
+    offsets.push_back(table->storage.size());
+    conmat::FormatTo(table->storage, "", codes);
+    size_t prefix_end = table->storage.size();
+    offsets.push_back(prefix_end);
+    if (style.reset_after && prefix_end != offsets[offsets.size() - 2]) {
+      conmat::FormatTo(table->storage, "", reset);
+    }
+  }
+  offsets.push_back(table->storage.size());
+
+  std::string_view storage = table->storage;
+  table->codes.reserve(table->options.size());
+  for (size_t i = 0; i < table->options.size(); ++i) {
+    size_t prefix = offsets[2 * i];
+    size_t suffix = offsets[2 * i + 1];
+    size_t next = offsets[2 * i + 2];
+    table->codes.push_back({storage.substr(prefix, suffix - prefix),
+                            storage.substr(suffix, next - suffix)});
+  }
+
+  active_.store(table.get(), std::memory_order_seq_cst);
+  std::unique_ptr<const Table> replaced = std::move(table_);
+  table_ = std::move(table);
+  return replaced;
+}
+
+// Free a replaced table once no reader can still see it. Called without
+// mutex_, so registration and lookups never wait for readers.
+void ThemeRegistry::Retire(std::unique_ptr<const Table> table) {
+  std::lock_guard<std::mutex> lock(retire_mutex_);
+  readers_->Synchronize();
+  table.reset();
+}
+
+} // namespace conmat
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "conmat.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Handle of a named style in a ThemeRegistry
+///
+/// Handles are small indices that stay valid across theme swaps. A
+/// default constructed handle formats text without escape codes.
+///
+////////////////////////////////////////////////////////////
+class StyleHandle {
+public:
+  constexpr StyleHandle() = default;
+
+  constexpr uint32_t index() const { return index_; }
+  constexpr bool valid() const { return index_ != kInvalid; }
+
+  constexpr bool operator==(const StyleHandle &) const = default;
+
+private:
+  friend class ThemeRegistry;
+
+  static constexpr uint32_t kInvalid = UINT32_MAX;
+
+  constexpr explicit StyleHandle(uint32_t index) : index_(index) {}
+
+  uint32_t index_ = kInvalid;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Named style of a theme
+///
+////////////////////////////////////////////////////////////
+struct ThemeEntry {
+  std::string_view name;
+  FormatOptions options;
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Escape codes written around text of one style
+///
+////////////////////////////////////////////////////////////
+struct StyleCodes {
+  std::string_view prefix; // Style and color codes
+  std::string_view suffix; // Reset code, empty if not needed
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Registry resolving style names to precomputed escape codes
+///
+/// Names are resolved to StyleHandles once, at setup time. The active
+/// theme is an immutable table with the prefix and suffix of every
+/// handle, so formatting by handle is an atomic load, an array lookup
+/// and appends.
+///
+/// Load() and Set() build a new table and publish it with an atomic
+/// pointer swap; formatting threads never take a lock. A formatting
+/// call marks itself in a per-thread-sharded reader count, and a swap
+/// frees the replaced table once the calls that may still see it have
+/// finished, so memory stays bounded however often themes change.
+/// Registration and publishing are serialized with a mutex that is not
+/// held while a swap waits for readers.
+///
+/// \example
+/// ThemeRegistry themes;
+/// themes.Load({{"error", {Color::Red, Color::Default, Style::Bold}},
+///              {"path", {Color::Cyan}}});
+/// StyleHandle error = themes.Register("error");
+/// std::string line;
+/// themes.FormatTo(line, error, "file not found");
+///
+////////////////////////////////////////////////////////////
+class ThemeRegistry {
+  struct Table;
+  struct Readers;
+
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Pins the active theme while it exists
+  ///
+  /// Codes() views stay valid for the lifetime of the View, even if
+  /// another thread swaps the theme meanwhile: the swap waits for the
+  /// View to be destroyed before freeing the table. Keep Views
+  /// short-lived, and do not call Load() or Set() while the same thread
+  /// holds one.
+  ///
+  /// \example
+  /// ThemeRegistry::View theme = themes.Active();
+  /// StyleCodes codes = theme.Codes(error);
+  /// line.append(codes.prefix).append("text").append(codes.suffix);
+  ///
+  ////////////////////////////////////////////////////////////
+  class View {
+  public:
+    ~View();
+
+    View(const View &) = delete;
+    View &operator=(const View &) = delete;
+
+    ////////////////////////////////////////////////////////////
+    /// \brief Escape codes of a style in the pinned theme
+    ///
+    ////////////////////////////////////////////////////////////
+    StyleCodes Codes(StyleHandle handle) const;
+
+  private:
+    friend class ThemeRegistry;
+    explicit View(const ThemeRegistry &registry);
+
+    std::atomic<uint32_t> *count_; // Reader count this View is in
+    const Table *table_;
+  };
+
+  ThemeRegistry();
+  ~ThemeRegistry();
+
+  ThemeRegistry(const ThemeRegistry &) = delete;
+  ThemeRegistry &operator=(const ThemeRegistry &) = delete;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Get the handle of a name, registering it if needed
+  ///
+  /// A name that no theme defines formats as plain text.
+  ///
+  /// \param name Style name
+  /// \return Handle of the name, stable for the registry's lifetime
+  ///
+  ////////////////////////////////////////////////////////////
+  StyleHandle Register(std::string_view name);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Look up the handle of a name without registering it
+  /// \return The handle, or an invalid handle if the name is unknown
+  ///
+  ////////////////////////////////////////////////////////////
+  StyleHandle Find(std::string_view name) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Replace the active theme
+  ///
+  /// Names not listed are reset to plain text; new names are
+  /// registered.
+  ///
+  /// \param entries Styles of the new theme
+  ///
+  ////////////////////////////////////////////////////////////
+  void Load(const std::vector<ThemeEntry> &entries);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Change one style of the active theme
+  /// \param name Style name (registered if needed)
+  /// \param options New formatting of the style
+  ///
+  ////////////////////////////////////////////////////////////
+  void Set(std::string_view name, const FormatOptions &options);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Pin the active theme to read its escape codes
+  ///
+  ////////////////////////////////////////////////////////////
+  View Active() const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Append sanitized text in a style of the active theme
+  /// \param out String the formatted text is appended to
+  /// \param handle Style handle
+  /// \param text The text to format
+  ///
+  ////////////////////////////////////////////////////////////
+  void FormatTo(std::string &out, StyleHandle handle,
+                std::string_view text) const;
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Format text in a style of the active theme
+  /// \return The formatted string
+  ///
+  ////////////////////////////////////////////////////////////
+  std::string Format(StyleHandle handle, std::string_view text) const;
+
+private:
+  std::unique_ptr<const Table> Publish(std::vector<FormatOptions> options);
+  void Retire(std::unique_ptr<const Table> table);
+
+  std::atomic<const Table *> active_{nullptr};
+  std::unique_ptr<Readers> readers_; // Formatting calls in progress
+  std::mutex retire_mutex_;          // Serializes waits for readers
+  mutable std::mutex mutex_;
+  std::map<std::string, uint32_t, std::less<>> handles_;
+  std::unique_ptr<const Table> table_; // Owns the active table
+};
+
+} // namespace conmat
@@ -0,0 +1,59 @@
+#include "conmat_tree.h"
+#include "conmat_stats_scope.h"
+#include <algorithm>
+
+namespace conmat {
+
+TreeRenderer::TreeRenderer(BufferedSink &sink, TreeGuides guides)
+    : sink_(sink), guides_(guides) {}
+
+void TreeRenderer::SetDepthOptions(std::vector<FormatOptions> options) {
+  depth_options_ = std::move(options);
+}
+
+void TreeRenderer::Push(std::string_view label, bool last) {
+  CONMAT_STATS_SCOPE(stats::Api::Tree, label.size());
+  std::string &out = sink_.buffer();
+  [[maybe_unused]] size_t start = out.size();
+
+  size_t level = segments_.size();
+  out.append(prefix_);
+  if (level > 0) {
+    out.append(last ? guides_.last_branch : guides_.branch);
+  }
+  AppendLabel(label);
+  out.push_back('\n');
+  CONMAT_STATS_OUTPUT(out.size() - start, 0);
+
+  // Children of a root need no guide for it
+  std::string_view segment;
+  if (level > 0) {
+    segment = last ? guides_.blank : guides_.vertical;
+  }
+  prefix_.append(segment);
+  segments_.push_back(segment.size());
+  sink_.MaybeFlush();
+}
+
+void TreeRenderer::Pop() {
+  if (segments_.empty()) {
+    return;
+  }
+  prefix_.resize(prefix_.size() - segments_.back());
+  segments_.pop_back();
+}
+
+void TreeRenderer::AppendLabel(std::string_view label) {
+  std::string &out = sink_.buffer();
+  if (depth_options_.empty()) {
+    // Default options without a reset only sanitize
+    FormatOptions plain;
+    plain.reset_after = false;
+    FormatTo(out, label, plain);
+    return;
+  }
+  size_t level = std::min(segments_.size(), depth_options_.size() - 1);
+  FormatTo(out, label, depth_options_[level]);
+}
+
+} // namespace conmat
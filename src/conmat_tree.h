@@ -0,0 +1,178 @@
+#pragma once
+
+#include "conmat.h"
+#include "conmat_sink.h"
+#include <cstddef>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace conmat {
+
+////////////////////////////////////////////////////////////
+/// \brief Guide strings drawn in front of tree nodes
+///
+/// The views must outlive the TreeRenderer using them. All four strings
+/// should have the same display width.
+///
+////////////////////////////////////////////////////////////
+struct TreeGuides {
+  std::string_view branch = "├── ";      // Node with later siblings
+  std::string_view last_branch = "└── "; // Last child of its parent
+  std::string_view vertical = "│   ";    // Ancestor with later siblings
+  std::string_view blank = "    ";       // Ancestor that was a last child
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Guides made of ASCII characters only
+  ///
+  ////////////////////////////////////////////////////////////
+  static constexpr TreeGuides Ascii() {
+    return {"|-- ", "`-- ", "|   ", "    "};
+  }
+};
+
+////////////////////////////////////////////////////////////
+/// \brief Streaming tree renderer with box-drawing guides
+///
+/// Nodes are written one line each, in pre-order, straight into a
+/// BufferedSink. The guide prefix of the current path is kept as one
+/// string that grows on Push() and shrinks on Pop(), so each line copies
+/// the existing prefix bytes instead of rebuilding them and memory use is
+/// proportional to the depth, not the number of nodes.
+///
+/// Nodes pushed at depth 0 are roots and have no guide. Labels are
+/// sanitized like Format() and should not contain line breaks.
+///
+/// \example
+/// BufferedSink sink(1);
+/// TreeRenderer tree(sink);
+/// tree.Push("root");
+/// tree.Leaf("a");
+/// tree.Push("b", true);
+/// tree.Leaf("c", true);
+/// // root
+/// // ├── a
+/// // └── b
+/// //     └── c
+///
+////////////////////////////////////////////////////////////
+class TreeRenderer {
+public:
+  ////////////////////////////////////////////////////////////
+  /// \brief Create a renderer writing to a sink
+  /// \param sink Output for the rendered lines
+  /// \param guides Guide strings (default: Unicode box drawing)
+  ///
+  ////////////////////////////////////////////////////////////
+  explicit TreeRenderer(BufferedSink &sink, TreeGuides guides = {});
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Set label formatting per depth
+  ///
+  /// Labels at depth d use options[d]; deeper labels use the last entry.
+  /// With no options labels are written unformatted.
+  ///
+  /// \param options Format options indexed by depth
+  ///
+  ////////////////////////////////////////////////////////////
+  void SetDepthOptions(std::vector<FormatOptions> options);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Write a node and descend into it
+  /// \param label Text of the node
+  /// \param last Whether this is the last child of its parent
+  ///
+  ////////////////////////////////////////////////////////////
+  void Push(std::string_view label, bool last = false);
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Return to the parent of the current node
+  ///
+  /// Does nothing at depth 0.
+  ///
+  ////////////////////////////////////////////////////////////
+  void Pop();
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Write a node without children
+  /// \param label Text of the node
+  /// \param last Whether this is the last child of its parent
+  ///
+  ////////////////////////////////////////////////////////////
+  void Leaf(std::string_view label, bool last = false) {
+    Push(label, last);
+    Pop();
+  }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Number of nodes on the current path
+  ///
+  ////////////////////////////////////////////////////////////
+  size_t depth() const { return segments_.size(); }
+
+  ////////////////////////////////////////////////////////////
+  /// \brief Render a whole tree with a pre-order walk
+  ///
+  /// Uses an explicit stack of child iterators, so deep trees do not
+  /// recurse. The children function must return a borrowed range (for
+  /// example a reference to a member container).
+  ///
+  /// \param root Root node
+  /// \param children Returns the child range of a node
+  /// \param label Returns the label of a node
+  ///
+  /// \example
+  /// tree.Render(root,
+  ///             [](const Dir &d) -> const auto & { return d.entries; },
+  ///             [](const Dir &d) { return std::string_view(d.name); });
+  ///
+  ////////////////////////////////////////////////////////////
+  template <typename Node, typename Children, typename Label>
+    requires std::ranges::borrowed_range<
+        std::invoke_result_t<Children &, const Node &>>
+  void Render(const Node &root, Children children, Label label);
+
+private:
+  void AppendLabel(std::string_view label);
+
+  BufferedSink &sink_;
+  TreeGuides guides_;
+  std::vector<FormatOptions> depth_options_;
+  std::string prefix_;           // Guides of the current path
+  std::vector<size_t> segments_; // Bytes each open node added to prefix_
+};
+
+template <typename Node, typename Children, typename Label>
+  requires std::ranges::borrowed_range<
+      std::invoke_result_t<Children &, const Node &>>
+void TreeRenderer::Render(const Node &root, Children children, Label label) {
+  using Range = std::invoke_result_t<Children &, const Node &>;
+  using Iterator = std::ranges::iterator_t<Range>;
+  using Sentinel = std::ranges::sentinel_t<Range>;
+
+  Push(label(root), true);
+
+  std::vector<std::pair<Iterator, Sentinel>> stack;
+  Range root_children = children(root);
+  stack.emplace_back(std::ranges::begin(root_children),
+                     std::ranges::end(root_children));
+  while (!stack.empty()) {
+    auto &[it, end] = stack.back();
+    if (it == end) {
+      stack.pop_back();
+      Pop();
+      continue;
+    }
+    const Node &node = *it;
+    bool last = ++it == end;
+    Push(label(node), last);
+    Range node_children = children(node);
+    stack.emplace_back(std::ranges::begin(node_children),
+                       std::ranges::end(node_children));
+  }
+}
+
+} // namespace conmat
@@ -0,0 +1,163 @@
+#include "conmat_html.h"
+#include "conmat_sink.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Size of each read from the input
+constexpr size_t kChunkSize = size_t{1} << 20;
+
+// Output is written in blocks of this size
+constexpr size_t kOutputBufferSize = size_t{1} << 22;
+
+struct Options {
+  bool fragment = false;
+  std::string title = "conmat";
+  std::string output_path;
+  std::vector<std::string> inputs;
+};
+
+void PrintUsage() {
+  std::cerr
+      << "Usage: conmat_html [options] [FILE...]\n"
+      << "Convert ANSI colored text from FILEs (or stdin) to HTML.\n\n"
+      << "  --fragment       Emit only the converted text, no document\n"
+      << "  --title TITLE    Document title (default: conmat)\n"
+      << "  -o FILE          Write output to FILE instead of stdout\n"
+      << "  -h, --help       Show this help\n";
+}
+
+void AppendEscaped(std::string_view text, conmat::BufferedSink &sink) {
+  for (char c : text) {
+    switch (c) {
+    case '&':
+      sink.Append("&amp;");
+      break;
+    case '<':
+      sink.Append("&lt;");
+      break;
+    case '>':
+      sink.Append("&gt;");
+      break;
+    default:
+      sink.Append(c);
+      break;
+    }
+  }
+}
+
+bool Convert(int fd, conmat::AnsiToHtml &converter,
+             conmat::BufferedSink &sink) {
+  std::string chunk(kChunkSize, '\0');
+  while (true) {
+    ssize_t n = ::read(fd, chunk.data(), chunk.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    converter.Feed(std::string_view(chunk.data(), static_cast<size_t>(n)),
+                   sink.buffer());
+    sink.MaybeFlush();
+  }
+}
+
+bool ParseArguments(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--fragment") {
+      options.fragment = true;
+    } else if (arg == "--title" && i + 1 < argc) {
+      options.title = argv[++i];
+    } else if (arg == "-o" && i + 1 < argc) {
+      options.output_path = argv[++i];
+    } else if (arg == "-h" || arg == "--help") {
+      PrintUsage();
+      std::exit(0);
+    } else if (arg.size() > 1 && arg.front() == '-' && arg != "-") {
+      std::cerr << "conmat_html: unknown option '" << arg << "'\n";
+      return false;
+    } else {
+      options.inputs.emplace_back(arg);
+    }
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseArguments(argc, argv, options)) {
+    PrintUsage();
+    return 2;
+  }
+
+  int out_fd = STDOUT_FILENO;
+  if (!options.output_path.empty()) {
+    out_fd = ::open(options.output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                    0644);
+    if (out_fd < 0) {
+      std::cerr << "conmat_html: " << options.output_path << ": "
+                << std::strerror(errno) << '\n';
+      return 1;
+    }
+  }
+
+  bool ok = true;
+  {
+    conmat::BufferedSink sink(out_fd, kOutputBufferSize);
+    if (!options.fragment) {
+      sink.Append("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+                  "<title>");
+      AppendEscaped(options.title, sink);
+      sink.Append("</title>\n<style>\n");
+      sink.Append(conmat::AnsiToHtml::Stylesheet());
+      sink.Append("</style>\n</head>\n<body>\n<pre class=\"ansi\">");
+    }
+
+    // One converter for all inputs, so styling carries over like `cat`
+    conmat::AnsiToHtml converter;
+    if (options.inputs.empty()) {
+      options.inputs.emplace_back("-");
+    }
+    for (const std::string &input : options.inputs) {
+      int fd = input == "-" ? STDIN_FILENO : ::open(input.c_str(), O_RDONLY);
+      if (fd < 0 || !Convert(fd, converter, sink)) {
+        std::cerr << "conmat_html: " << input << ": " << std::strerror(errno)
+                  << '\n';
+        ok = false;
+      }
+      if (fd > STDIN_FILENO) {
+        ::close(fd);
+      }
+    }
+    converter.Finish(sink.buffer());
+
+    if (!options.fragment) {
+      sink.Append("</pre>\n</body>\n</html>\n");
+    }
+    if (!sink.Flush()) {
+      std::cerr << "conmat_html: write error: " << std::strerror(errno)
+                << '\n';
+      ok = false;
+    }
+  }
+
+  if (out_fd != STDOUT_FILENO) {
+    ::close(out_fd);
+  }
+  return ok ? 0 : 1;
+}
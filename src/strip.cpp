@@ -0,0 +1,262 @@
+#include "conmat.h"
+#include "conmat_ansi.h"
+#include "conmat_sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Size of each read from stdin and of each window handed to the stripper
+constexpr size_t kChunkSize = size_t{1} << 20;
+
+// Output is written in blocks of this size
+constexpr size_t kOutputBufferSize = size_t{1} << 22;
+
+// Files smaller than this are never split across threads
+constexpr size_t kMinParallelSize = size_t{1} << 23;
+
+// Target size of each segment processed by one thread
+constexpr size_t kSegmentSize = size_t{1} << 24;
+
+struct Options {
+  bool sanitize_only = false;
+  unsigned jobs = 1;
+  std::string output_path;
+  std::vector<std::string> inputs;
+};
+
+void PrintUsage() {
+  std::cerr
+      << "Usage: conmat_strip [options] [FILE...]\n"
+      << "Remove ANSI escape sequences from FILEs (or stdin) and write the\n"
+      << "result to stdout.\n\n"
+      << "  --sanitize-only  Only drop control bytes (conmat::Sanitize)\n"
+      << "  -j, --jobs N     Split large files into N parallel segments\n"
+      << "                   (0 uses every hardware thread)\n"
+      << "  -o FILE          Write output to FILE instead of stdout\n"
+      << "  -h, --help       Show this help\n";
+}
+
+// Strip or sanitize one window, appending to out
+class Processor {
+public:
+  explicit Processor(bool sanitize_only) : sanitize_only_(sanitize_only) {}
+
+  void Feed(std::string_view chunk, std::string &out) {
+    if (sanitize_only_) {
+      out.append(conmat::SanitizeView(chunk, storage_));
+    } else {
+      stripper_.Feed(chunk, out);
+    }
+  }
+
+private:
+  bool sanitize_only_;
+  conmat::AnsiStripper stripper_;
+  std::string storage_; // Reused when a chunk needs sanitizing
+};
+
+void ProcessSequential(std::string_view data, bool sanitize_only,
+                       conmat::BufferedSink &sink) {
+  Processor processor(sanitize_only);
+  while (!data.empty()) {
+    std::string_view window = data.substr(0, kChunkSize);
+    processor.Feed(window, sink.buffer());
+    sink.MaybeFlush();
+    data.remove_prefix(window.size());
+  }
+}
+
+// Split data into segments that end just after a line feed. The stripper
+// is always in its ground state after a line feed, so segments can be
+// processed independently and concatenated.
+std::vector<std::string_view> SplitAtLines(std::string_view data,
+                                           size_t segment_size) {
+  std::vector<std::string_view> segments;
+  while (!data.empty()) {
+    size_t cut = data.size();
+    if (data.size() > segment_size) {
+      size_t newline = data.find('\n', segment_size);
+      cut = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    segments.push_back(data.substr(0, cut));
+    data.remove_prefix(cut);
+  }
+  return segments;
+}
+
+void ProcessParallel(std::string_view data, const Options &options,
+                     conmat::BufferedSink &sink) {
+  std::vector<std::string_view> segments = SplitAtLines(data, kSegmentSize);
+  std::vector<std::string> outputs(options.jobs);
+
+  // Process segments in waves of `jobs`, writing each wave in order
+  for (size_t first = 0; first < segments.size(); first += options.jobs) {
+    size_t count = std::min<size_t>(options.jobs, segments.size() - first);
+    std::vector<std::thread> workers;
+    workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      workers.emplace_back([&, i] {
+        std::string &out = outputs[i];
+        out.clear();
+        out.reserve(segments[first + i].size());
+        Processor(options.sanitize_only).Feed(segments[first + i], out);
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    for (size_t i = 0; i < count; ++i) {
+      sink.Append(outputs[i]);
+    }
+  }
+}
+
+bool ProcessStream(int fd, const Options &options,
+                   conmat::BufferedSink &sink) {
+  Processor processor(options.sanitize_only);
+  std::string chunk(kChunkSize, '\0');
+  while (true) {
+    ssize_t n = ::read(fd, chunk.data(), chunk.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    processor.Feed(std::string_view(chunk.data(), static_cast<size_t>(n)),
+                   sink.buffer());
+    sink.MaybeFlush();
+  }
+}
+
+bool ProcessFile(const std::string &path, const Options &options,
+                 conmat::BufferedSink &sink) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "conmat_strip: " << path << ": " << std::strerror(errno)
+              << '\n';
+    return false;
+  }
+
+  struct stat info {};
+  bool ok = true;
+  if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    size_t size = static_cast<size_t>(info.st_size);
+    void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      ::madvise(mapped, size, MADV_SEQUENTIAL);
+      std::string_view data(static_cast<const char *>(mapped), size);
+      if (options.jobs > 1 && size >= kMinParallelSize) {
+        ProcessParallel(data, options, sink);
+      } else {
+        ProcessSequential(data, options.sanitize_only, sink);
+      }
+      ::munmap(mapped, size);
+    } else {
+      ok = ProcessStream(fd, options, sink);
+    }
+  } else {
+    // Pipes, devices and empty files
+    ok = ProcessStream(fd, options, sink);
+  }
+
+  if (!ok) {
+    std::cerr << "conmat_strip: " << path << ": " << std::strerror(errno)
+              << '\n';
+  }
+  ::close(fd);
+  return ok;
+}
+
+bool ParseArguments(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--sanitize-only") {
+      options.sanitize_only = true;
+    } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+      std::string_view value = argv[++i];
+      auto [end, error] = std::from_chars(
+          value.data(), value.data() + value.size(), options.jobs);
+      if (error != std::errc() || end != value.data() + value.size()) {
+        std::cerr << "conmat_strip: invalid job count '" << value << "'\n";
+        return false;
+      }
+      if (options.jobs == 0) {
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+      }
+    } else if (arg == "-o" && i + 1 < argc) {
+      options.output_path = argv[++i];
+    } else if (arg == "-h" || arg == "--help") {
+      PrintUsage();
+      std::exit(0);
+    } else if (arg.size() > 1 && arg.front() == '-' && arg != "-") {
+      std::cerr << "conmat_strip: unknown option '" << arg << "'\n";
+      return false;
+    } else {
+      options.inputs.emplace_back(arg);
+    }
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseArguments(argc, argv, options)) {
+    PrintUsage();
+    return 2;
+  }
+
+  int out_fd = STDOUT_FILENO;
+  if (!options.output_path.empty()) {
+    out_fd = ::open(options.output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                    0644);
+    if (out_fd < 0) {
+      std::cerr << "conmat_strip: " << options.output_path << ": "
+                << std::strerror(errno) << '\n';
+      return 1;
+    }
+  }
+
+  bool ok = true;
+  {
+    conmat::BufferedSink sink(out_fd, kOutputBufferSize);
+    if (options.inputs.empty()) {
+      options.inputs.emplace_back("-");
+    }
+    for (const std::string &input : options.inputs) {
+      if (input == "-") {
+        ok = ProcessStream(STDIN_FILENO, options, sink) && ok;
+      } else {
+        ok = ProcessFile(input, options, sink) && ok;
+      }
+    }
+    if (!sink.Flush()) {
+      std::cerr << "conmat_strip: write error: " << std::strerror(errno)
+                << '\n';
+      ok = false;
+    }
+  }
+
+  if (out_fd != STDOUT_FILENO) {
+    ::close(out_fd);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+// Allocation budgets of the hot-path APIs.
+//
+// Replaces the global allocation functions with counting versions that
+// also report to conmat::stats::CountAllocation(). Every call is made once to warm buffers and function statics,
+// then measured; a call allocating more than its budget fails the test.
+
+#include "conmat.h"
+#include "conmat_ansi.h"
+#include "conmat_chart.h"
+#include "conmat_diff.h"
+#include "conmat_fixed.h"
+#include "conmat_gradient.h"
+#include "conmat_html.h"
+#include "conmat_json.h"
+#include "conmat_panel.h"
+#include "conmat_profile.h"
+#include "conmat_sink.h"
+#include "conmat_stats.h"
+#include "conmat_styled_string.h"
+#include "conmat_text.h"
+#include "conmat_theme.h"
+#include "conmat_tree.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+
+size_t g_allocations = 0;
+size_t g_bytes = 0;
+int g_failures = 0;
+volatile size_t g_sink = 0; // Keeps results observable
+
+template <typename Call>
+void CheckBudget(std::string_view name, size_t budget, Call &&call) {
+  call();
+  size_t allocations = g_allocations;
+  size_t bytes = g_bytes;
+  call();
+  allocations = g_allocations - allocations;
+  bytes = g_bytes - bytes;
+
+  bool ok = allocations <= budget;
+  if (!ok) {
+    ++g_failures;
+  }
+  std::cout << (ok ? conmat::TestPassed() : conmat::TestFailed()) << ' '
+            << name << std::string(name.size() < 36 ? 36 - name.size() : 1, ' ')
+            << allocations << " alloc (budget " << budget << "), " << bytes
+            << " bytes\n";
+}
+
+} // anonymous namespace
+
+// Counting replacements of the global allocation functions. The array,
+// nothrow and sized forms all route through these by default.
+void *operator new(std::size_t size) {
+  ++g_allocations;
+  g_bytes += size;
+  conmat::stats::CountAllocation();
+  if (size == 0) {
+    size = 1;
+  }
+  for (;;) {
+    if (void *memory = std::malloc(size)) {
+      return memory;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  ++g_allocations;
+  g_bytes += size;
+  conmat::stats::CountAllocation();
+  size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc needs a size that is a multiple of the alignment
+  size = (std::max<size_t>(size, 1) + align - 1) / align * align;
+  for (;;) {
+#if defined(_WIN32)
+    void *memory = _aligned_malloc(size, align);
+#else
+    void *memory = std::aligned_alloc(align, size);
+#endif
+    if (memory != nullptr) {
+      return memory;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+#if defined(_WIN32)
+  _aligned_free(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+void operator delete(void *memory, std::size_t,
+                     std::align_val_t alignment) noexcept {
+  operator delete(memory, alignment);
+}
+
+int main() {
+  using namespace conmat;
+
+  std::cout << Header("allocation budgets", 2) << "\n\n";
+
+  const std::string colored = "\033[1;31merror\033[0m: bad \033[2Ainput";
+  const std::string line = "the quick brown fox jumps over the lazy dog";
+  const std::vector<double> samples = {1, 5, 2, 8, 3, 9, 4, 7, 6, 0};
+  const SgrColor stops[] = {Rgb(255, 0, 0), Rgb(0, 0, 255)};
+  std::string out;
+  out.reserve(4096);
+
+  // Allocating wrappers: the result string at most. Results are longer
+  // than the small-string buffer so the allocation is actually counted.
+  CheckBudget("Format", 1,
+              [&] { g_sink = Format(line, Color::Red).size(); });
+  CheckBudget("Colorize", 1,
+              [&] { g_sink = Colorize(line, Color::Green).size(); });
+  CheckBudget("Colorize(number)", 1,
+              [] { g_sink = Colorize(-1234567890, Color::Green).size(); });
+  CheckBudget("Stylize", 1,
+              [&] { g_sink = Stylize(line, Style::Bold).size(); });
+  CheckBudget("Header", 1, [] { g_sink = Header("title", 1, 40).size(); });
+  CheckBudget("Divider", 1, [] { g_sink = Divider(40).size(); });
+  // Formatting goes through FormatImpl: the plain text plus its result
+  CheckBudget("Header(formatted)", 2, [] {
+    g_sink = Header("title", 1, 40, {Color::Cyan}).size();
+  });
+  CheckBudget("Divider(formatted)", 2,
+              [] { g_sink = Divider(40, {Color::Cyan}).size(); });
+  CheckBudget("Indent", 1, [] { g_sink = Indent(10).size(); });
+  // Fits the small-string buffer
+  CheckBudget("TestPassed", 0, [] { g_sink = TestPassed().size(); });
+  CheckBudget("Sanitize", 1, [&] { g_sink = Sanitize(line).size(); });
+  CheckBudget("StripAnsi", 1, [&] { g_sink = StripAnsi(colored).size(); });
+  CheckBudget("SanitizeSgr", 1, [&] { g_sink = SanitizeSgr(colored).size(); });
+  CheckBudget("Truncate", 1, [&] { g_sink = Truncate(line, 12).size(); });
+  CheckBudget("Gradient", 1, [&] { g_sink = Gradient(line, stops).size(); });
+  // Markup outgrows the guessed reservation once
+  CheckBudget("AnsiToHtmlString", 2,
+              [&] { g_sink = AnsiToHtmlString(colored).size(); });
+  // The nesting stack, and markup outgrowing the guessed reservation
+  CheckBudget("HighlightJson", 3, [] {
+    g_sink = HighlightJson("{\"a\": [1, true, \"x\"]}").size();
+  });
+  // Line breaks are inserted into a copy of the words
+  CheckBudget("Wrap", 1, [&] { g_sink = Wrap(line, 16, 1).size(); });
+  CheckBudget("Sparkline", 1, [&] { g_sink = Sparkline(samples).size(); });
+  // Report APIs: the budgets record today's cost so regressions show.
+  // Histogram keeps per-bin counts and labels and grows its result;
+  // Diff splits both texts into lines and builds the edit script and
+  // the character highlights of changed lines.
+  CheckBudget("Histogram", 9, [&] { g_sink = Histogram(samples).size(); });
+  CheckBudget("Diff", 44, [] {
+    g_sink = Diff("alpha\nbeta\ngamma\n", "alpha\nbeta!\ngamma\n").size();
+  });
+
+  // Queries never allocate
+  CheckBudget("NeedsSanitize", 0, [&] { g_sink = NeedsSanitize(line); });
+  CheckBudget("SanitizeView(clean)", 0, [&] {
+    std::string storage;
+    g_sink = SanitizeView(line, storage).size();
+  });
+  CheckBudget("DisplayWidth", 0, [&] { g_sink = DisplayWidth(colored); });
+
+  // Appending variants into a warm buffer
+  CheckBudget("FormatTo", 0, [&] {
+    out.clear();
+    FormatTo(out, line, {Color::Red, Color::Default, Style::Bold});
+  });
+  CheckBudget("TruncateTo", 0, [&] {
+    out.clear();
+    TruncateTo(out, colored, 8, "…", TruncateMode::Middle);
+  });
+  CheckBudget("GradientTo", 0, [&] {
+    out.clear();
+    GradientTo(out, line, stops);
+  });
+  CheckBudget("BarTo", 0, [&] {
+    out.clear();
+    BarTo(out, 0.4, 20, {Color::Cyan});
+  });
+  CheckBudget("SparklineTo", 0, [&] {
+    out.clear();
+    SparklineTo(out, samples);
+  });
+  CheckBudget("SparklineTo(colors)", 0, [&] {
+    out.clear();
+    SparklineTo(out, samples, {.colors = stops});
+  });
+
+  AnsiStripper stripper;
+  CheckBudget("AnsiStripper::Feed", 0, [&] {
+    out.clear();
+    stripper.Feed(colored, out);
+  });
+  SgrSanitizer sanitizer;
+  CheckBudget("SgrSanitizer::Feed", 0, [&] {
+    out.clear();
+    sanitizer.Feed(colored, out);
+    sanitizer.Finish(out);
+  });
+  AnsiToHtml html;
+  CheckBudget("AnsiToHtml::Feed", 0, [&] {
+    out.clear();
+    html.Feed(colored, out);
+  });
+  WordWrapper wrapper(16, 1);
+  CheckBudget("WordWrapper::Feed", 0, [&] {
+    out.clear();
+    wrapper.Feed(line, out);
+  });
+  JsonHighlighter json;
+  CheckBudget("JsonHighlighter::Feed", 0, [&] {
+    out.clear();
+    json.Feed("{\"a\": [1, true, \"x\"]}", out);
+  });
+
+  ThemeRegistry theme;
+  theme.Set("error", {Color::Red, Color::Default, Style::Bold});
+  StyleHandle error = theme.Find("error");
+  CheckBudget("ThemeRegistry::FormatTo", 0, [&] {
+    out.clear();
+    theme.FormatTo(out, error, line);
+  });
+
+  StyledString styled("error", {Color::Red, Style::Bold});
+  styled.Append(": ").Append("file.txt", Color::Cyan);
+  CheckBudget("StyledString::RenderTo", 0, [&] {
+    out.clear();
+    styled.RenderTo(out);
+  });
+  // The text outgrows the small-string buffer and the run list grows
+  CheckBudget("StyledString::Append", 3, [] {
+    StyledString text("error", {Color::Red, Style::Bold});
+    text.Append(": a longer message").Append("file.txt", Color::Cyan);
+    g_sink = text.size();
+  });
+  // The text of the slice
+  CheckBudget("StyledString::Slice", 1,
+              [&] { g_sink = styled.Slice(3, 20).size(); });
+
+  std::string tree_out;
+  tree_out.reserve(4096);
+  BufferedSink tree_sink(tree_out);
+  TreeRenderer tree(tree_sink);
+  CheckBudget("TreeRenderer::Push", 0, [&] {
+    tree_out.clear();
+    tree.Push("root", true);
+    tree.Leaf("a");
+    tree.Leaf("b", true);
+    tree.Pop();
+    tree_sink.Flush();
+  });
+
+  Panel panel({.width = 40, .border = {Color::Blue}}, "panel");
+  Panel nested({.border_style = BorderStyle::Rounded, .width = 30});
+  CheckBudget("Panel::RenderTo", 0, [&] {
+    out.clear();
+    panel.RenderTo(out, colored);
+  });
+  CheckBudget("Panel::RenderTo(nested)", 0, [&] {
+    out.clear();
+    panel.RenderTo(out, nested, "one\ntwo");
+  });
+
+  CheckBudget("FixedFormatter", 0, [] {
+    FixedFormatter<256> fixed;
+    fixed.Header("crash", 1, 40, {Color::Red}).AppendNumber(3.5);
+    g_sink = fixed.size();
+  });
+  LineBuffer buffer(-1);
+  CheckBudget("LineBuffer::Append", 0, [&] {
+    buffer.Append(line);
+    buffer.Append('\n');
+    buffer.Discard();
+  });
+  CheckBudget("CONMAT_PROFILE_SCOPE", 0,
+              [] { CONMAT_PROFILE_SCOPE("budget"); });
+
+  std::cout << '\n'
+            << (g_failures == 0 ? "All allocation budgets met"
+                                : "Allocation budgets exceeded")
+            << std::endl;
+  return g_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
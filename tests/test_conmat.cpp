@@ -1,7 +1,32 @@
 #include "conmat.h"
+#include "conmat_ansi.h"
+#include "conmat_chart.h"
+#include "conmat_diff.h"
+#include "conmat_fixed.h"
+#include "conmat_gradient.h"
+#include "conmat_html.h"
+#include "conmat_json.h"
+#include "conmat_panel.h"
+#include "conmat_profile.h"
+#include "conmat_sink.h"
+#include "conmat_stats.h"
+#include "conmat_stream.h"
+#include "conmat_styled_string.h"
+#include "conmat_text.h"
+#include "conmat_theme.h"
+#include "conmat_tree.h"
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <cassert>
+#include <sstream>
 #include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <thread>
+#include <unistd.h>
+#endif
 
 void test_color_formatting() {
   using namespace conmat;
@@ -239,6 +264,29 @@ void test_format_with_numeric_types() {
   std::cout << "✓ Format with numeric types test passed" << std::endl;
 }
 
+struct TestVersion {
+  int major;
+  int minor;
+};
+
+std::ostream &operator<<(std::ostream &os, const TestVersion &version) {
+  return os << 'v' << version.major << '.' << version.minor;
+}
+
+// Types printed by a member operator<< of std::ostream are rejected the
+// same way whether or not <ostream> is included
+static_assert(conmat::Formattable<TestVersion>);
+static_assert(!conmat::Formattable<const void *>);
+
+void test_format_streamable() {
+  using namespace conmat;
+  
+  assert(Colorize(TestVersion{1, 2}, Color::Cyan) == "\033[36mv1.2\033[0m");
+  assert(StripAnsi(Format(TestVersion{0, 9})) == "v0.9");
+  
+  std::cout << "✓ Format streamable test passed" << std::endl;
+}
+
 void test_mixed_string_and_numeric() {
   using namespace conmat;
   
@@ -454,6 +502,1098 @@ void test_header_empty_text() {
   std::cout << "✓ Header empty text test passed" << std::endl;
 }
 
+void test_strip_ansi_sequences() {
+  using namespace conmat;
+  
+  // Private mode, cursor movement and OSC title sequences are removed
+  assert(StripAnsi("\033[?25lhidden\033[?25h") == "hidden");
+  assert(StripAnsi("\033[2Aup") == "up");
+  assert(StripAnsi("\033]0;title\007text") == "text");
+  assert(StripAnsi("\033]8;;http://x\033\\link") == "link");
+  
+  // Lone ESC bytes and unterminated sequences are dropped
+  assert(StripAnsi("a\033\nb") == "a\nb");
+  assert(StripAnsi("text\033[31") == "text");
+  
+  std::cout << "✓ Strip ANSI sequences test passed" << std::endl;
+}
+
+void test_ansi_stripper_streaming() {
+  using namespace conmat;
+  
+  std::string input = "\033[1;31mbold red\033[0m plain \033]0;t\007end\n";
+  std::string expected = StripAnsi(input);
+  assert(expected == "bold red plain end\n");
+  
+  // Every split point must give the same result as one chunk
+  for (size_t cut = 0; cut <= input.size(); ++cut) {
+    AnsiStripper stripper;
+    std::string out;
+    stripper.Feed(std::string_view(input).substr(0, cut), out);
+    stripper.Feed(std::string_view(input).substr(cut), out);
+    assert(out == expected);
+  }
+  
+  // Byte at a time
+  AnsiStripper stripper;
+  std::string out;
+  for (char c : input) {
+    stripper.Feed(std::string_view(&c, 1), out);
+  }
+  assert(out == expected);
+  
+  std::cout << "✓ ANSI stripper streaming test passed" << std::endl;
+}
+
+void test_sgr_state() {
+  using namespace conmat;
+  
+  SgrState state;
+  state.Apply("1;31");
+  assert(state.attributes == sgr_attribute::Bold);
+  assert(state.foreground.BasicIndex() == 1);
+  
+  state.Apply("22;44");
+  assert(state.attributes == 0);
+  assert(state.background.BasicIndex() == 4);
+  
+  state.Apply("38;5;196");
+  assert(state.foreground.kind == SgrColor::Kind::Indexed);
+  assert(state.foreground.index == 196);
+  assert(state.foreground.BasicIndex() == 9); // bright red
+  
+  state.Apply("38;2;0;205;0");
+  assert(state.foreground.kind == SgrColor::Kind::Rgb);
+  assert(state.foreground.BasicIndex() == 2); // green
+  
+  std::string rendered;
+  state.AppendTo(rendered);
+  assert(rendered == "\033[38;2;0;205;0;44m");
+  
+  state.Apply("");
+  assert(state.IsDefault());
+  
+  std::cout << "✓ SGR state test passed" << std::endl;
+}
+
+void test_ansi_to_html() {
+  using namespace conmat;
+  
+  // Colors emitted by conmat itself map onto classes
+  std::string html = AnsiToHtmlString(Colorize("ok", Color::Green));
+  assert(html == "<span class=\"ansi-green\">ok</span>");
+  
+  html = AnsiToHtmlString(Format("x", FormatOptions(Color::BrightRed,
+                                                    Color::Blue, Style::Bold)));
+  assert(html == "<span class=\"ansi-bright-red ansi-bg-blue ansi-bold\">x</span>");
+  
+  // Text is escaped and adjacent identical spans are merged
+  html = AnsiToHtmlString("\033[31ma<b\033[0m\033[31m&c\033[0m plain");
+  assert(html == "<span class=\"ansi-red\">a&lt;b&amp;c</span> plain");
+  
+  // Sequences split across chunks
+  AnsiToHtml converter;
+  std::string out;
+  converter.Feed("\033[3", out);
+  converter.Feed("4mblue\033[", out);
+  converter.Feed("0m", out);
+  converter.Finish(out);
+  assert(out == "<span class=\"ansi-blue\">blue</span>");
+  
+  std::cout << "✓ ANSI to HTML test passed" << std::endl;
+}
+
+void test_sanitize_fast_path() {
+  using namespace conmat;
+  
+  // Clean input is returned as the original view
+  std::string storage;
+  std::string_view clean = "plain text with UTF-8 ✓ and\ttabs\n";
+  assert(!NeedsSanitize(clean));
+  std::string_view view = SanitizeView(clean, storage);
+  assert(view.data() == clean.data());
+  assert(storage.empty());
+  
+  // Control bytes anywhere in a long string are found
+  std::string dirty(100, 'a');
+  dirty[70] = '\x1b';
+  dirty[71] = '\x7f';
+  assert(NeedsSanitize(dirty));
+  view = SanitizeView(dirty, storage);
+  assert(view == std::string(98, 'a'));
+  assert(view.data() == storage.data());
+  
+  // Input that sanitizes to nothing
+  assert(Sanitize("\x1b\x01").empty());
+  
+  // rvalue overload compacts in place
+  std::string moved = "a\x1b[31mb\x07" "c";
+  std::string result = Sanitize(std::move(moved));
+  assert(result == "a[31mbc");
+  
+  std::cout << "✓ Sanitize fast path test passed" << std::endl;
+}
+
+void test_format_to() {
+  using namespace conmat;
+  
+  std::string out = "> ";
+  FormatTo(out, "test", FormatOptions(Color::Red));
+  assert(out == "> \033[31mtest\033[0m");
+  
+  // Output matches FormatImpl, including for dirty input
+  std::string expected = FormatImpl("a\x1b" "b", FormatOptions(Color::Green));
+  out.clear();
+  FormatTo(out, "a\x1b" "b", FormatOptions(Color::Green));
+  assert(out == expected);
+  assert(out == "\033[32mab\033[0m");
+  
+  std::cout << "✓ FormatTo test passed" << std::endl;
+}
+
+// Count tokens at compile time to check constexpr support
+constexpr size_t CountAnsiTokens(std::string_view text) {
+  size_t count = 0;
+  for (const conmat::AnsiToken &token : conmat::AnsiTokenizer(text)) {
+    count += token.text.empty() ? 0 : 1;
+  }
+  return count;
+}
+
+static_assert(CountAnsiTokens("\033[1;31mred\033[0m") == 3);
+static_assert(CountAnsiTokens("plain") == 1);
+static_assert(CountAnsiTokens("") == 0);
+
+void test_ansi_tokenizer() {
+  using namespace conmat;
+  
+  std::string input = "a\033[1;38;5;196mb\033[2Jc\033]0;t\007d\033(Be";
+  std::vector<AnsiToken> tokens;
+  for (const AnsiToken &token : AnsiTokenizer(input)) {
+    tokens.push_back(token);
+  }
+  
+  // Views point into the input
+  assert(tokens.size() == 9);
+  assert(tokens[0].kind == AnsiTokenKind::Text && tokens[0].text == "a");
+  assert(tokens[0].text.data() == input.data());
+  assert(tokens[1].kind == AnsiTokenKind::Sgr);
+  assert(tokens[1].parameters == "1;38;5;196");
+  std::vector<uint32_t> values(tokens[1].sgr_parameters().begin(),
+                               tokens[1].sgr_parameters().end());
+  assert((values == std::vector<uint32_t>{1, 38, 5, 196}));
+  assert(tokens[3].kind == AnsiTokenKind::Csi && tokens[3].final_byte == 'J');
+  assert(tokens[5].kind == AnsiTokenKind::Osc && tokens[5].complete);
+  assert(tokens[7].kind == AnsiTokenKind::Other);
+  assert(tokens[7].text == "\033(B");
+  assert(tokens[8].text == "e");
+  
+  // Reset with no parameters reads as a single 0
+  AnsiToken reset = ScanAnsiToken("\033[m");
+  assert(reset.kind == AnsiTokenKind::Sgr);
+  assert(reset.sgr_parameters().size() == 1);
+  assert(*reset.sgr_parameters().begin() == 0);
+  
+  // Aborted and unterminated sequences
+  AnsiToken aborted = ScanAnsiToken("\033[31\nx");
+  assert(!aborted.complete && aborted.text == "\033[31");
+  AnsiToken unterminated = ScanAnsiToken("\033]0;title");
+  assert(!unterminated.complete && unterminated.kind == AnsiTokenKind::Osc);
+  
+  // Long text runs are found past SIMD block boundaries
+  std::string long_text(1000, 'x');
+  long_text[777] = '\033';
+  assert(ScanAnsiToken(long_text).text.size() == 777);
+  
+  // The tokenizer and the streaming parser agree on random input
+  const char alphabet[] = "\033\033[]P(3;1m\n\a\\a \x7f";
+  uint32_t seed = 12345;
+  for (int round = 0; round < 2000; ++round) {
+    std::string random;
+    for (int i = 0; i < 24; ++i) {
+      seed = seed * 1103515245u + 12345u;
+      random.push_back(alphabet[(seed >> 16) % (sizeof(alphabet) - 1)]);
+    }
+    AnsiStripper stripper;
+    std::string streamed;
+    stripper.Feed(random, streamed);
+    assert(streamed == StripAnsi(random));
+  }
+  
+  std::cout << "✓ ANSI tokenizer test passed" << std::endl;
+}
+
+void test_stats() {
+  using namespace conmat;
+  
+  stats::Reset();
+  std::string colored = Colorize("counted", Color::Red);
+  std::string header = Header("stats", 1, 40, FormatOptions(Color::Cyan));
+  stats::Counters counters = stats::Snapshot();
+  
+  if (stats::Enabled()) {
+    const stats::ApiCounters &format = counters[stats::Api::FormatImpl];
+    assert(format.calls == 2); // Colorize + Header's formatting
+    assert(format.input_bytes == 7 + 40);
+    assert(format.output_bytes == colored.size() + header.size());
+    assert(format.escape_bytes == 2 * 9);
+    assert(counters[stats::Api::Header].calls == 1);
+    assert(counters[stats::Api::Header].escape_bytes == 9);
+    // No operator new here reports to CountAllocation()
+    assert(format.allocations == 0);
+  } else {
+    assert(counters[stats::Api::FormatImpl].calls == 0);
+  }
+  
+  // The report is rendered with conmat's own Header
+  std::string report = stats::Report(counters);
+  assert(report.find("conmat stats") != std::string::npos);
+  assert(stats::ApiName(stats::Api::StripAnsi) == "StripAnsi");
+  
+  std::cout << "✓ Stats test passed" << std::endl;
+}
+
+void test_display_width() {
+  using namespace conmat;
+  
+  assert(DisplayWidth("hello") == 5);
+  assert(DisplayWidth(Colorize("ok", Color::Green)) == 2);
+  assert(DisplayWidth("\u65e5\u672c") == 4);    // CJK is double width
+  assert(DisplayWidth("e\u0301") == 1);         // combining accent
+  assert(DisplayWidth("\xff") == 1);            // invalid UTF-8
+  
+  std::cout << "✓ Display width test passed" << std::endl;
+}
+
+void test_wrap() {
+  using namespace conmat;
+  
+  assert(Wrap("the quick brown fox", 10) == "the quick\nbrown fox");
+  assert(Wrap("aaa bbb ccc", 7, 1) == "aaa bbb\n  ccc");
+  assert(Wrap("abcdefghij", 4) == "abcd\nefgh\nij");
+  assert(Wrap("one\ntwo three", 5) == "one\ntwo\nthree");
+  assert(Wrap("\u65e5\u672c\u8a9e", 4) == "\u65e5\u672c\n\u8a9e");
+  
+  // Style is closed before each break and reopened after it
+  std::string wrapped = Wrap(Colorize("aaa bbb", Color::Red), 4);
+  assert(wrapped == "\033[31maaa\033[0m\n\033[31mbbb\033[0m");
+  for (size_t start = 0; start < wrapped.size();) {
+    size_t end = wrapped.find('\n', start);
+    std::string line = wrapped.substr(start, end - start);
+    assert(DisplayWidth(line) <= 4);
+    start = end == std::string::npos ? wrapped.size() : end + 1;
+  }
+  
+  // Chunked input wraps exactly like the whole string
+  std::string text = Colorize("lorem ipsum dolor sit amet", Color::Blue) +
+                     " consectetur " + Stylize("adipiscing", Style::Bold);
+  WordWrapper wrapper(16, 1);
+  std::string streamed;
+  for (char c : text) {
+    wrapper.Feed(std::string_view(&c, 1), streamed);
+  }
+  wrapper.Finish(streamed);
+  assert(streamed == Wrap(text, 16, 1));
+  assert(StripAnsi(streamed) ==
+         "lorem ipsum\n  dolor sit amet\n  consectetur\n  adipiscing");
+  
+  // A word longer than a line is placed as it arrives, not buffered
+  std::string piece(3, 'x');
+  WordWrapper long_wrapper(8);
+  std::string long_out;
+  for (int i = 0; i < 1000; ++i) {
+    long_wrapper.Feed(piece, long_out);
+  }
+  assert(long_out.size() >= 3000 + 374 - 8);
+  long_wrapper.Finish(long_out);
+  assert(long_out == Wrap(std::string(3000, 'x'), 8));
+  
+  // Split words start on a new line when a line break would not make
+  // them fit either
+  std::string split_text =
+      "a bbbbbbbbb " + Colorize("cccccccccccc", Color::Red);
+  WordWrapper split_wrapper(10, 2);
+  std::string split_streamed;
+  for (char c : split_text) {
+    split_wrapper.Feed(std::string_view(&c, 1), split_streamed);
+  }
+  split_wrapper.Finish(split_streamed);
+  assert(split_streamed == Wrap(split_text, 10, 2));
+  assert(StripAnsi(split_streamed) ==
+         "a\n    bbbbbb\n    bbb\n    cccccc\n    cccccc");
+  
+  // An indent wider than the width keeps one column for text
+  assert(Wrap("aaaa bbbb", 4, 3) == "aaaa\n   b\n   b\n   b\n   b");
+  
+  std::cout << "✓ Wrap test passed" << std::endl;
+}
+
+void test_truncate() {
+  using namespace conmat;
+  
+  assert(Truncate("short", 10) == "short");
+  assert(Truncate("exactly10!", 10) == "exactly10!");
+  assert(Truncate("truncate me", 8) == "truncat…");
+  assert(Truncate("/usr/local/include", 12, "...", TruncateMode::Middle) ==
+         "/usr/...lude");
+  assert(Truncate("/usr/local/include", 8, "...", TruncateMode::Start) ==
+         "...clude");
+  
+  // Escapes before the cut are kept and an open style is closed
+  std::string red = Colorize("conmat_theme.cpp", Color::Cyan);
+  assert(Truncate(red, 10) == "\033[36mconmat_th\033[0m…");
+  assert(Truncate(red, 20) == red);
+  assert(Truncate("\033[1mbold\033[0m plain text", 9) ==
+         "\033[1mbold\033[0m pla…");
+  
+  // The kept tail reopens the style it starts in
+  assert(Truncate("\033[31mred\033[0m \033[32mgreen\033[0m", 4, "…",
+                  TruncateMode::Start) == "…\033[32meen\033[0m");
+  
+  // Wide characters are never split; a too-wide ellipsis is dropped
+  assert(Truncate("日本語テキスト", 7) == "日本語…");
+  assert(DisplayWidth(Truncate("日本語テキスト", 6, "…",
+                               TruncateMode::Middle)) <= 6);
+  assert(Truncate("abcdef", 2, "...") == "ab");
+  
+  std::string out = "> ";
+  TruncateTo(out, "appended text", 6);
+  assert(out == "> appen…");
+  
+  std::cout << "✓ Truncate test passed" << std::endl;
+}
+
+struct TestTreeNode {
+  std::string name;
+  std::vector<TestTreeNode> children;
+};
+
+void test_tree_renderer() {
+  using namespace conmat;
+  
+  std::string out;
+  {
+    BufferedSink sink(out, 16);
+    TreeRenderer tree(sink);
+    tree.Push("root");
+    tree.Leaf("a");
+    tree.Push("b", true);
+    tree.Push("c");
+    tree.Leaf("d", true);
+    tree.Pop();
+    tree.Leaf("e", true);
+    assert(tree.depth() == 2);
+  }
+  assert(out == "root\n"
+                "├── a\n"
+                "└── b\n"
+                "    ├── c\n"
+                "    │   └── d\n"
+                "    └── e\n");
+  
+  // Pre-order walk, ASCII guides and per-depth formatting
+  TestTreeNode root{"root", {{"x", {{"y", {}}}}, {"z", {}}}};
+  out.clear();
+  {
+    BufferedSink sink(out);
+    TreeRenderer tree(sink, TreeGuides::Ascii());
+    FormatOptions bold;
+    bold.style = Style::Bold;
+    tree.SetDepthOptions({bold, FormatOptions{}});
+    tree.Render(
+        root,
+        [](const TestTreeNode &node) -> const std::vector<TestTreeNode> & {
+          return node.children;
+        },
+        [](const TestTreeNode &node) { return std::string_view(node.name); });
+    assert(tree.depth() == 0);
+  }
+  assert(out.starts_with(Stylize("root", Style::Bold) + "\n"));
+  assert(StripAnsi(out) == "root\n|-- x\n|   `-- y\n`-- z\n");
+  
+  std::cout << "✓ Tree renderer test passed" << std::endl;
+}
+
+void test_diff() {
+  using namespace conmat;
+  
+  DiffOptions plain;
+  plain.color = false;
+  plain.context = 1;
+  
+  assert(Diff("same\n", "same\n").empty());
+  assert(Diff("a\nb\nc\nd\ne\nf\ng\n", "a\nb\nc\nD\ne\nf\ng\nh\n", plain) ==
+         "--- expected\n"
+         "+++ actual\n"
+         "@@ -3,3 +3,3 @@\n"
+         " c\n"
+         "-d\n"
+         "+D\n"
+         " e\n"
+         "@@ -7 +7,2 @@\n"
+         " g\n"
+         "+h\n");
+  
+  plain.layout = DiffLayout::SideBySide;
+  plain.width = 17;
+  assert(Diff("x\nold line\n", "x\nnew\nadded\n", plain) ==
+         "expecte   actual\n"
+         "@@ -1,2 +1,3 @@\n"
+         "x         x\n"
+         "old lin | new\n"
+         "        > added\n");
+  
+  // Changed characters are highlighted within a changed line
+  std::string colored = Diff("value = 42", "value = 43");
+  assert(colored.find(Format("2", {Color::Red, Color::Default, Style::Reverse})) !=
+         std::string::npos);
+  assert(colored.find(Format("3", {Color::Green, Color::Default, Style::Reverse})) !=
+         std::string::npos);
+  
+  // A missing final line break changes the last line, and its marker
+  // follows that line; an empty text has no last line
+  DiffOptions plain_unified{.color = false};
+  assert(Diff("x\n", "", plain_unified) ==
+         "--- expected\n+++ actual\n@@ -1 +0,0 @@\n-x\n");
+  assert(Diff("", "x\n", plain_unified) ==
+         "--- expected\n+++ actual\n@@ -0,0 +1 @@\n+x\n");
+  assert(Diff("a\nb", "a\nb\n", plain_unified) ==
+         "--- expected\n+++ actual\n@@ -1,2 +1,2 @@\n a\n-b\n"
+         "\\ No newline at end of expected\n+b\n");
+  assert(Diff("a\nb\nc", "a\nB\nc\n", plain_unified) ==
+         "--- expected\n+++ actual\n@@ -1,3 +1,3 @@\n a\n-b\n-c\n"
+         "\\ No newline at end of expected\n+B\n+c\n");
+  assert(Diff("a\nb", "a\nc", plain_unified)
+             .ends_with("-b\n\\ No newline at end of expected\n"
+                        "+c\n\\ No newline at end of actual\n"));
+  
+  // Large inputs with many scattered edits
+  std::string expected;
+  std::string actual;
+  for (int i = 0; i < 20000; ++i) {
+    std::string line = "line " + std::to_string(i) + "\n";
+    expected += line;
+    actual += i % 97 == 0 ? "changed " + line : line;
+  }
+  std::string large = Diff(expected, actual, DiffOptions{.color = false});
+  size_t removed = 0;
+  for (size_t pos = 0; (pos = large.find("\n-", pos)) != std::string::npos; ++pos) {
+    ++removed;
+  }
+  assert(removed == (20000 + 96) / 97);
+  
+  std::cout << "✓ Diff test passed" << std::endl;
+}
+
+void test_json_highlighter() {
+  using namespace conmat;
+  
+  std::string json = "{\"id\": 7, \"ok\": true,\"tags\":[\"a\", \"b\\\"c\"], \"none\": {}}";
+  std::string pretty = HighlightJson(json);
+  assert(StripAnsi(pretty) == "{\n"
+                              "  \"id\": 7,\n"
+                              "  \"ok\": true,\n"
+                              "  \"tags\": [\n"
+                              "    \"a\",\n"
+                              "    \"b\\\"c\"\n"
+                              "  ],\n"
+                              "  \"none\": {}\n"
+                              "}\n");
+  assert(pretty.find(Format("\"id\"", {Color::Blue, Color::Default, Style::Bold})) !=
+         std::string::npos);
+  assert(pretty.find(Colorize("\"a\"", Color::Green)) != std::string::npos);
+  assert(pretty.find(Colorize("7", Color::Cyan)) != std::string::npos);
+  assert(pretty.find(Colorize("true", Color::Yellow)) != std::string::npos);
+  
+  // Single-line layout, JSON Lines and escapes injected into strings
+  JsonOptions compact;
+  compact.indent = 0;
+  assert(StripAnsi(HighlightJson("[1, 2]\n{\"k\": \"\x1b[31m\"}", compact)) ==
+         "[1,2]\n{\"k\":\"[31m\"}\n");
+  
+  // Chunked input gives the same output
+  JsonHighlighter highlighter;
+  std::string streamed;
+  for (char c : json) {
+    highlighter.Feed(std::string_view(&c, 1), streamed);
+  }
+  highlighter.Finish(streamed);
+  assert(streamed == pretty);
+  
+  std::cout << "✓ JSON highlighter test passed" << std::endl;
+}
+
+void test_theme_registry() {
+  using namespace conmat;
+  
+  ThemeRegistry themes;
+  StyleHandle error = themes.Register("error");
+  assert(themes.Register("error") == error);
+  assert(!themes.Find("missing").valid());
+  
+  // Unthemed names format as sanitized plain text
+  assert(themes.Format(error, "a\x01" "b") == "ab");
+  assert(themes.Format(StyleHandle(), "text") == "text");
+  
+  FormatOptions bold_red{Color::Red, Color::Default, Style::Bold};
+  themes.Load({{"error", bold_red}, {"path", {Color::Cyan}}});
+  StyleHandle path = themes.Find("path");
+  assert(path.valid());
+  assert(themes.Format(error, "boom") == Format("boom", bold_red));
+  
+  // A View pins the codes it hands out; handles keep their meaning
+  // across swaps
+  {
+    ThemeRegistry::View theme = themes.Active();
+    StyleCodes codes = theme.Codes(path);
+    assert(Colorize("x", Color::Cyan) ==
+           std::string(codes.prefix) + "x" + std::string(codes.suffix));
+    assert(theme.Codes(StyleHandle()).prefix.empty());
+  }
+  themes.Set("path", {Color::Magenta});
+  std::string line;
+  themes.FormatTo(line, path, "/tmp");
+  assert(line == Colorize("/tmp", Color::Magenta));
+  assert(themes.Format(error, "boom") == Format("boom", bold_red));
+  
+  themes.Load({{"path", {Color::Green}}});
+  assert(themes.Format(error, "boom") == "boom");
+  
+#if !defined(_WIN32)
+  // Replaced tables are freed while other threads keep formatting
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&] {
+      std::string out;
+      while (!done.load(std::memory_order_relaxed)) {
+        out.clear();
+        themes.FormatTo(out, path, "/tmp");
+        assert(out == Colorize("/tmp", Color::Green) ||
+               out == Colorize("/tmp", Color::Blue));
+      }
+    });
+  }
+  for (int i = 0; i < 2000; ++i) {
+    themes.Set("path", {i % 2 ? Color::Green : Color::Blue});
+  }
+  done = true;
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  
+  // A swap waiting for a View does not block registration or lookups
+  std::thread writer;
+  {
+    ThemeRegistry::View theme = themes.Active();
+    StyleCodes codes = theme.Codes(path);
+    writer = std::thread([&] { themes.Set("path", {Color::Red}); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    assert(themes.Register("late").valid());
+    assert(themes.Find("path") == path);
+    assert(std::string(codes.prefix) == "\033[32m");
+  }
+  writer.join();
+  assert(themes.Format(path, "x") == Colorize("x", Color::Red));
+#endif
+  
+  std::cout << "✓ Theme registry test passed" << std::endl;
+}
+
+void test_line_buffer() {
+  using namespace conmat;
+  
+#if !defined(_WIN32)
+  int fds[2];
+  int piped = pipe(fds);
+  assert(piped == 0);
+  (void)piped;
+  std::string received;
+  std::thread reader([&] {
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+      received.append(chunk, static_cast<size_t>(n));
+    }
+  });
+  
+  // Groups of a header and rows from several threads
+  constexpr int kThreads = 4;
+  constexpr int kGroups = 200;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; ++t) {
+    writers.emplace_back([t, fd = fds[1]] {
+      LineBuffer &out = ThreadLineBuffer(fd);
+      assert(&ThreadLineBuffer(fd) == &out);
+      for (int g = 0; g < kGroups; ++g) {
+        for (int row = 0; row < 4; ++row) {
+          out.Append(std::to_string(t) + " " + std::to_string(g) + " " +
+                     std::to_string(row) + " " + std::string(40, 'x'));
+          out.Append('\n');
+        }
+        out.Commit();
+      }
+      // Larger than one atomic write: split at line breaks
+      for (size_t row = 0; row < 2 * kAtomicWriteSize / 64; ++row) {
+        out.Append(std::to_string(t) + " big " + std::string(57, 'y'));
+        out.Append('\n');
+      }
+      bool committed = out.Commit();
+      assert(committed);
+      (void)committed;
+    });
+  }
+  for (std::thread &writer : writers) {
+    writer.join();
+  }
+  close(fds[1]);
+  reader.join();
+  close(fds[0]);
+  
+  // Lines are whole, groups are contiguous and commits stay in order
+  std::istringstream lines(received);
+  std::string line;
+  int next_group[kThreads] = {};
+  int big_rows[kThreads] = {};
+  int last_thread = -1;
+  int last_row = 3;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    int t;
+    std::string group;
+    fields >> t >> group;
+    assert(t >= 0 && t < kThreads);
+    if (group == "big") {
+      assert(line.size() == 64 - 1);
+      assert(next_group[t] == kGroups);
+      ++big_rows[t];
+      continue;
+    }
+    int row;
+    fields >> row;
+    assert(line.size() == std::to_string(t).size() + group.size() +
+                               std::to_string(row).size() + 43);
+    if (row == 0) {
+      assert(last_row == 3);
+      assert(std::stoi(group) == next_group[t]++);
+    } else {
+      assert(t == last_thread && row == last_row + 1);
+    }
+    last_thread = t;
+    last_row = row;
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    assert(next_group[t] == kGroups);
+    assert(big_rows[t] == static_cast<int>(2 * kAtomicWriteSize / 64));
+  }
+#endif
+  
+  // Regular targets get one write per commit
+  LineBuffer discard(-1);
+  discard.Append("lost");
+  discard.Discard();
+  bool committed = discard.Commit();
+  assert(committed && discard.buffer().empty());
+  (void)committed;
+  
+  std::cout << "✓ Line buffer test passed" << std::endl;
+}
+
+void test_gradient() {
+  using namespace conmat;
+  
+  // One prefix per run of equal colors and a single reset
+  const SgrColor flat[] = {Rgb(0, 200, 0), Rgb(0, 200, 0)};
+  assert(Gradient("bar\x01", flat) ==
+         "\033[38;2;0;200;0mbar\033[0m");
+  assert(Gradient("", flat).empty());
+  
+  // Multi-line text keeps its line breaks and tabs, which take no color
+  const SgrColor two[] = {Rgb(255, 0, 0), Rgb(0, 0, 255)};
+  assert(Gradient("ab\r\n\tcd", two) ==
+         "\033[38;2;255;0;0ma\033[38;2;170;0;85mb\r\n\t"
+         "\033[38;2;85;0;170mc\033[38;2;0;0;255md\033[0m");
+  
+  const SgrColor heat[] = {Rgb(0, 200, 0), Rgb(220, 0, 0)};
+  std::string out;
+  const double values[] = {0.0, 0.0, 1.0, 1.0};
+  ColorByValueTo(out, "abcde", values, heat);
+  assert(out == "\033[38;2;0;200;0mab\033[38;2;220;0;0mcd\033[39me");
+  
+  // Long gradients collapse to the few colors the depth can show
+  std::string bar(200, '#');
+  std::string basic = Gradient(bar, heat, ColorDepth::Basic);
+  assert(StripAnsi(basic) == bar);
+  size_t escapes = 0;
+  for (char c : basic) {
+    escapes += c == '\033';
+  }
+  assert(escapes >= 2 && escapes <= 4);
+  assert(GradientColor(heat, 0.5) == Rgb(110, 100, 0));
+  
+  // Combining marks share the color of their base character
+  out.clear();
+  ColorCharactersTo(out, "e\u0301x", [](size_t index) {
+    return SgrColor{SgrColor::Kind::Indexed, static_cast<uint8_t>(index + 1)};
+  });
+  assert(out == "\033[31me\u0301\033[32mx\033[0m");
+  
+  assert(QuantizeColor(Rgb(255, 0, 0), ColorDepth::Palette).index == 196);
+  assert(QuantizeColor(Rgb(128, 128, 128), ColorDepth::Palette).index == 244);
+  assert(QuantizeColor(Rgb(255, 0, 0), ColorDepth::Basic).kind ==
+         SgrColor::Kind::Indexed);
+  
+  std::cout << "✓ Gradient test passed" << std::endl;
+}
+
+void test_charts() {
+  using namespace conmat;
+  
+  // Buckets split the series evenly and keep min, max and mean
+  const double series[] = {1, 5, 3, 3, 2, 8, 0, 4};
+  SeriesBucket buckets[3];
+  assert(Downsample(series, buckets) == 3);
+  assert(buckets[0].min == 1 && buckets[0].max == 5 && buckets[0].mean == 3);
+  assert(buckets[2].min == 0 && buckets[2].max == 8 && buckets[2].mean == 4);
+  
+  const double ramp[] = {0, 1, 2, 3, 4, 5, 6, 7};
+  assert(Sparkline(ramp) == "▁▂▃▄▅▆▇█");
+  assert(Sparkline(ramp, {.width = 4, .value = SparklineValue::Min}) ==
+         "▁▃▆█");
+  assert(Sparkline(ramp, {.width = 2, .low = 0, .high = 14}) == "▃▅");
+  assert(Sparkline(std::span<const double>()).empty());
+  std::vector<double> wide(2000, 1.0);
+  assert(DisplayWidth(Sparkline(wide, {.width = 1000})) ==
+         kMaxSparklineWidth);
+  
+  // Equal neighbours share one color sequence
+  const SgrColor colors[] = {Rgb(0, 200, 0), Rgb(220, 0, 0)};
+  const double steps[] = {0, 0, 0, 7, 7};
+  assert(Sparkline(steps, {.colors = colors}) ==
+         "\033[38;2;0;200;0m▁▁▁\033[38;2;220;0;0m██\033[0m");
+  
+  std::string bar;
+  BarTo(bar, 0.45, 4);
+  assert(bar == "█▊  ");
+  bar.clear();
+  BarTo(bar, 2.0, 2, {Color::Green});
+  assert(bar == Colorize("██", Color::Green));
+  
+  const double samples[] = {0, 1, 1, 2, 2, 2, 3, 4};
+  assert(Histogram(samples, {.bins = 2, .width = 4, .bar = {}}) ==
+         "0 │██▍ │ 3\n"
+         "2 │████│ 5\n");
+  
+  std::cout << "✓ Chart test passed" << std::endl;
+}
+
+void test_styled_string() {
+  using namespace conmat;
+  
+  // Renders like the equivalent Format calls, with one reset at the end
+  StyledString line("error", {Color::Red, Style::Bold});
+  line.Append(": ").Append("file\x01.txt", Color::Cyan);
+  assert(line.text() == "error: file.txt");
+  assert(line.run_count() == 3);
+  assert(line.DisplayWidth() == 15);
+  assert(line.Render() == "\033[1;31merror\033[0m: \033[36mfile.txt\033[0m");
+  
+  // Same-style appends extend the last run
+  StyledString plain("a");
+  plain.Append("b").Append("c", Style::Default);
+  assert(plain.run_count() == 1 && plain.Render() == "abc");
+  
+  // Slices keep their styles; concatenation merges equal neighbours
+  StyledString word = line.Slice(3, 6);
+  assert(word.text() == "or: fi");
+  assert(word.StyleAt(0) == TextStyle(Color::Red, Style::Bold));
+  assert(word.StyleAt(2) == TextStyle());
+  StyledString joined = line.Slice(0, 2) + line.Slice(2, 3);
+  assert(joined == line.Slice(0, 5) && joined.run_count() == 1);
+  
+  // Restyling splits and merges runs; style changes use one sequence
+  line.Restyle(0, 7, Color::Cyan);
+  assert(line.run_count() == 1);
+  line.Restyle(2, 1, TextStyle(Color::Green).With(Style::Underline));
+  assert(line.run_count() == 3);
+  assert(line.Render() ==
+         "\033[36mer\033[0;4;32mr\033[0;36mor: file.txt\033[0m");
+  
+  // Copies beyond the inline runs stay independent
+  StyledString many;
+  for (int i = 0; i < 8; ++i) {
+    many.Append("x", i % 2 ? Color::Red : Color::Blue);
+  }
+  StyledString copy = many;
+  many.clear();
+  assert(copy.run_count() == 8 && many.empty());
+  
+  std::cout << "✓ Styled string test passed" << std::endl;
+}
+
+void test_fixed_formatter() {
+  using namespace conmat;
+  
+  // Same output as the allocating functions
+  FixedFormatter<512> out;
+  FormatOptions red{Color::Red, Style::Bold};
+  out.TestFailed().Append(' ').Format("boom\x01", red).Append('\n');
+  out.Header("crash", 1, 40, {Color::Yellow}).Append('\n');
+  out.Divider("-=", 7).Indent(2).Divider(5, {Color::Blue});
+  out.Format(-42, {Color::Cyan}).AppendNumber(3.14159265).AppendNumber(7u);
+  std::string expected = TestFailed() + " " + Format("boom", red) + "\n" +
+                         Header("crash", 1, 40, {Color::Yellow}) + "\n" +
+                         Divider("-=", 7) + Indent(2) +
+                         Divider(5, {Color::Blue}) +
+                         Colorize(-42, Color::Cyan) + "3.141597";
+  assert(out.view() == expected);
+  assert(!out.truncated());
+  
+  // Overflow keeps the longest prefix and closes the open style
+  FixedFormatter<24> small;
+  small.Format("0123456789abcdef", {Color::Green}).Append("lost");
+  assert(small.truncated());
+  assert(small.view() == "\033[32m0123456789abcde\033[0m");
+  small.clear();
+  small.Append("1234567890123456789").Append("ü");
+  assert(small.view() == "1234567890123456789");
+  small.clear();
+  small.Append("1234567890123456789").Format("x", {Color::Red});
+  assert(small.view() == "1234567890123456789" && small.truncated());
+  
+  std::cout << "✓ Fixed formatter test passed" << std::endl;
+}
+
+void test_stream_support() {
+  using namespace conmat;
+  
+  std::ostringstream os;
+  os << Styled("error", Color::Red) << ": " << Styled(42, Style::Bold);
+  assert(os.str() == Colorize("error", Color::Red) + ": " +
+                         Stylize(42, Style::Bold));
+  
+  os.str("");
+  WriteFormatted(os, "plain");
+  assert(os.str() == Format("plain"));
+  
+  // Numbers match std::ostream default formatting without iostreams
+  assert(StripAnsi(Format(3.14159265)) == "3.14159");
+  assert(StripAnsi(Format(1e20)) == "1e+20");
+  assert(StripAnsi(Format(static_cast<unsigned char>('x'))) == "x");
+  
+  std::cout << "✓ Stream support test passed" << std::endl;
+}
+
+void test_sgr_sanitizer() {
+  using namespace conmat;
+  
+  // SGR is kept; cursor movement, titles and control bytes are not
+  assert(SanitizeSgr("\033[1;31merror\033[0m: \033[2Aup\033]0;title\a ok\a") ==
+         "\033[1;31merror\033[0m: up ok");
+  assert(SanitizeSgr("\033[?25lhidden\033[2J") == "hidden");
+  
+  // Attributes left active are reset at the end
+  assert(SanitizeSgr("\033[32mok") == "\033[32mok\033[0m");
+  assert(SanitizeSgr("\033[1mbold\033[22m") == "\033[1mbold\033[22m");
+  assert(SanitizeSgr("\033[53mover") == "\033[53mover\033[0m");
+  
+  // Malformed and unterminated sequences are dropped
+  assert(SanitizeSgr("a\033[3\"mb") == "ab");
+  assert(SanitizeSgr("a\033[31") == "a");
+  
+  // Basic policy maps extended colors and drops unknown codes
+  assert(SanitizeSgr("\033[1;38;5;196mhot\033[22mwarm\033[m", SgrPolicy::Basic) ==
+         "\033[1;91mhot\033[0;91mwarm\033[0m");
+  assert(SanitizeSgr("\033[53mover", SgrPolicy::Basic) == "over");
+  assert(SanitizeSgr("\033[38;2;0;205;0mgo", SgrPolicy::Basic) ==
+         "\033[32mgo\033[0m");
+  
+  std::cout << "✓ SGR sanitizer test passed" << std::endl;
+}
+
+void test_sgr_sanitizer_streaming() {
+  using namespace conmat;
+  
+  const std::string input =
+      "\033[1;33mwarn\033[0m x\033]8;;http://x\033\\link\033[5C\033[38;5;21mblue";
+  for (SgrPolicy policy : {SgrPolicy::Any, SgrPolicy::Basic}) {
+    std::string expected = SanitizeSgr(input, policy);
+    for (size_t cut = 0; cut <= input.size(); ++cut) {
+      SgrSanitizer sanitizer(policy);
+      std::string out;
+      sanitizer.Feed(std::string_view(input).substr(0, cut), out);
+      sanitizer.Feed(std::string_view(input).substr(cut), out);
+      sanitizer.Finish(out);
+      assert(out == expected);
+    }
+  }
+  
+  // Finish prepares the sanitizer for new input
+  SgrSanitizer sanitizer;
+  std::string out;
+  sanitizer.Feed("\033[31mred\033[3", out);
+  sanitizer.Finish(out);
+  assert(out == "\033[31mred\033[0m");
+  assert(sanitizer.state().IsDefault());
+  out.clear();
+  sanitizer.Feed("4mplain", out);
+  sanitizer.Finish(out);
+  assert(out == "4mplain");
+  
+  std::cout << "✓ SGR sanitizer streaming test passed" << std::endl;
+}
+
+void test_profile() {
+  using namespace conmat;
+  
+  profile::Reset();
+  auto work = [] {
+    CONMAT_PROFILE_SCOPE("outer");
+    for (int i = 0; i < 3; ++i) {
+      CONMAT_PROFILE_SCOPE("inner");
+      volatile int sink = 0;
+      for (int j = 0; j < 1000; ++j) {
+        sink = sink + j;
+      }
+    }
+  };
+  work();
+#if !defined(_WIN32)
+  std::thread worker(work);
+  worker.join();
+  const uint64_t expected_outer = 2;
+#else
+  const uint64_t expected_outer = 1;
+#endif
+  
+  // Threads merge by call path; children never exceed their parent
+  profile::CallNode tree = profile::CallTree();
+  assert(tree.children.size() == 1);
+  const profile::CallNode &outer = tree.children[0];
+  assert(outer.name == "outer");
+  assert(outer.calls == expected_outer);
+  assert(outer.children.size() == 1);
+  const profile::CallNode &inner = outer.children[0];
+  assert(inner.name == "inner");
+  assert(inner.calls == 3 * expected_outer);
+  assert(inner.total_ns <= outer.total_ns);
+  assert(outer.self_ns + inner.total_ns <= outer.total_ns * 1.0001);
+  assert(tree.total_ns == outer.total_ns);
+  
+  // Nested report with the hot spot colored
+  profile::ReportOptions options;
+  options.hot_percent = 0.0;
+  std::string report = profile::Report(tree, options);
+  assert(report.starts_with(Header("profile", 2)));
+  assert(report.find("100.0%") != std::string::npos);
+  assert(report.find("  outer\n") != std::string::npos);
+  assert(report.find("    inner\n") != std::string::npos);
+  assert(report.find("\033[31m") != std::string::npos);
+  options.min_percent = 101.0;
+  assert(profile::Report(tree, options).find("outer") == std::string::npos);
+  
+  // Chrome trace: one complete event per scope
+  std::string trace = profile::ChromeTrace();
+  assert(trace.starts_with("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  assert(trace.ends_with("]}\n"));
+  size_t events = 0;
+  for (size_t pos = 0; (pos = trace.find("\"ph\":\"X\"", pos)) != std::string::npos;
+       ++pos) {
+    ++events;
+  }
+  assert(events == 4 * expected_outer);
+  assert(trace.find("{\"name\":\"inner\",\"ph\":\"X\",\"pid\":1,\"tid\":") !=
+         std::string::npos);
+  
+  profile::Reset();
+  assert(profile::CallTree().children.empty());
+  assert(profile::Report(profile::CallTree()).find("no scopes recorded") !=
+         std::string::npos);
+  
+  std::cout << "✓ Profile test passed" << std::endl;
+}
+
+void test_panel() {
+  using namespace conmat;
+  
+  Panel panel({.border_style = BorderStyle::Rounded, .width = 24}, "Build");
+  assert(panel.width() == 24 && panel.inner_width() == 20);
+  assert(panel.Render("3 targets\n0 errors\n") ==
+         "╭─────── Build ────────╮\n"
+         "│ 3 targets            │\n"
+         "│ 0 errors             │\n"
+         "╰──────────────────────╯\n");
+  
+  // Padding by display width; SGR kept and closed, other escapes removed
+  Panel heavy({.border_style = BorderStyle::Heavy, .width = 10, .padding = 0});
+  assert(heavy.Render("日本\n\033[31mred\033[2A") ==
+         "┏━━━━━━━━┓\n"
+         "┃日本    ┃\n"
+         "┃\033[31mred\033[0m     ┃\n"
+         "┗━━━━━━━━┛\n");
+  
+  // Tabs and carriage returns from CRLF input never reach the row
+  assert(Panel({.width = 12}, "\tT\r").Render("a\tb\nwin\r\nok") ==
+         "┌─── T ────┐\n"
+         "│ ab       │\n"
+         "│ win      │\n"
+         "│ ok       │\n"
+         "└──────────┘\n");
+  
+  // Long lines and titles are truncated, too narrow titles dropped
+  Panel narrow({.border_style = BorderStyle::Double, .width = 9}, "Overlong");
+  assert(narrow.Render("abcdefghij") ==
+         "╔═ Ov… ═╗\n"
+         "║ abcd… ║\n"
+         "╚═══════╝\n");
+  assert(Panel({.width = 6}, "Title").Render("") == "┌────┐\n└────┘\n");
+  
+  // Formatting wraps the border and the body separately
+  Panel styled({.width = 8,
+                .border = {Color::Blue},
+                .title = {Color::Yellow},
+                .body = {Color::Green}},
+               "T");
+  std::string out = styled.Render("x");
+  assert(out.starts_with("\033[34m┌─ \033[0m\033[33mT\033[0m\033[34m ──┐"));
+  assert(out.find("\033[34m│\033[0m\033[32m x    \033[0m\033[34m│\033[0m\n") !=
+         std::string::npos);
+  assert(StripAnsi(out) == Panel({.width = 8}, "T").Render("x"));
+  
+  std::cout << "✓ Panel test passed" << std::endl;
+}
+
+void test_panel_nested() {
+  using namespace conmat;
+  
+  Panel outer({.width = 20}, "outer");
+  Panel inner({.border_style = BorderStyle::Rounded, .width = 12}, "in");
+  std::string out;
+  outer.RenderTo(out, inner, "a\nb");
+  std::string expected = outer.Render(inner.Render("a\nb"));
+  assert(out == expected);
+  assert(out ==
+         "┌───── outer ──────┐\n"
+         "│ ╭─── in ───╮     │\n"
+         "│ │ a        │     │\n"
+         "│ │ b        │     │\n"
+         "│ ╰──────────╯     │\n"
+         "└──────────────────┘\n");
+  
+  // Same result for formatted panels and for inner panels that do not fit
+  Panel green({.width = 20, .border = {Color::Green}, .body = {Color::Cyan}});
+  Panel red({.width = 10, .border = {Color::Red}});
+  out.clear();
+  green.RenderTo(out, red, "\033[1mx");
+  assert(StripAnsi(out) == StripAnsi(green.Render(red.Render("\033[1mx"))));
+  Panel wide({.width = 30});
+  out.clear();
+  red.RenderTo(out, wide, "x");
+  assert(out == red.Render(wide.Render("x")));
+  
+  std::cout << "✓ Nested panel test passed" << std::endl;
+}
+
 int main() {
   std::cout << "Running conmat tests..." << std::endl << std::endl;
   
@@ -472,6 +1612,7 @@ int main() {
   test_colorize_with_bool();
   test_stylize_with_numeric_types();
   test_format_with_numeric_types();
+  test_format_streamable();
   test_mixed_string_and_numeric();
   test_indent_default();
   test_indent_custom_spaces();
@@ -483,6 +1624,32 @@ int main() {
   test_header_long_text();
   test_header_formatting();
   test_header_empty_text();
+  test_strip_ansi_sequences();
+  test_ansi_stripper_streaming();
+  test_sgr_state();
+  test_ansi_to_html();
+  test_sanitize_fast_path();
+  test_format_to();
+  test_ansi_tokenizer();
+  test_stats();
+  test_stream_support();
+  test_display_width();
+  test_wrap();
+  test_tree_renderer();
+  test_diff();
+  test_json_highlighter();
+  test_theme_registry();
+  test_line_buffer();
+  test_gradient();
+  test_charts();
+  test_styled_string();
+  test_truncate();
+  test_fixed_formatter();
+  test_sgr_sanitizer();
+  test_sgr_sanitizer_streaming();
+  test_profile();
+  test_panel();
+  test_panel_nested();
   
   std::cout << std::endl << "All tests passed! ✓" << std::endl;
   